@@ -0,0 +1,83 @@
+project "Benchmark"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++20"
+	staticruntime "off"
+
+	targetdir ("%{wks.location}/bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("%{wks.location}/bin-int/" .. outputdir .. "/%{prj.name}")
+
+	-- Shaders are loaded relative to the Vulkan project
+	debugdir "%{wks.location}/Vulkan"
+
+	files
+	{
+		"src/**.h",
+		"src/**.cpp",
+		"%{wks.location}/Vulkan/src/**.h",
+		"%{wks.location}/Vulkan/src/**.cpp",
+	}
+
+	removefiles
+	{
+		"%{wks.location}/Vulkan/src/Main.cpp"
+	}
+
+	includedirs
+	{
+		"src",
+		"%{IncludeDir.GLFW}",
+		"%{IncludeDir.glm}",
+		"%{IncludeDir.VulkanSDK}",
+		"%{wks.location}/Vulkan/src",
+		"%{wks.location}/Vulkan/vendor",
+	}
+
+	links
+	{
+		"GLFW"
+	}
+
+	defines
+	{
+		"GLFW_INCLUDE_VULKAN"
+	}
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "configurations:Debug"
+		defines "VULKAN_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+		links
+		{
+			"%{Library.ShaderC_Debug}",
+			"%{Library.SPIRV_Cross_Debug}",
+			"%{Library.SPIRV_Cross_GLSL_Debug}",
+			"%{Library.Vulkan}"
+		}
+
+		postbuildcommands
+		{
+			"{COPYDIR} \"%{LibraryDir.VulkanSDK_DebugDLL}\" \"%{cfg.targetdir}\""
+		}
+
+	filter "configurations:Release"
+		defines "VULKAN_RELEASE"
+		runtime "Release"
+		optimize "on"
+
+		links
+		{
+			"%{Library.ShaderC_Release}",
+			"%{Library.SPIRV_Cross_Release}",
+			"%{Library.SPIRV_Cross_GLSL_Release}",
+			"%{Library.Vulkan}"
+		}
+
+		postbuildcommands
+		{
+			"{COPYDIR} \"%{LibraryDir.VulkanSDK_DebugDLL}\" \"%{cfg.targetdir}\""
+		}
@@ -0,0 +1,536 @@
+#include "VulkanRenderer.h"
+#include "VulkanShader.h"
+#include "VulkanUploader.h"
+#include "StressScene.h"
+
+#include "JsonWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkArguments
+{
+	uint32_t Draws = 20000;
+	uint32_t Frames = 100;
+	uint32_t MaxThreads = 0;
+	// The submission rate is measured from MinObjects up to MaxObjects, quadrupling every step
+	uint32_t MinObjects = 1000;
+	uint32_t MaxObjects = 64000;
+	uint32_t UploadMeshes = 128;
+	uint32_t UploadMeshVertices = 4096;
+	// Timings that only happen once per process are repeated this many times and the fastest kept
+	uint32_t Repetitions = 3;
+	std::string OutputPath = "benchmark.json";
+
+	// Drawn by the submission and frame time benchmarks, each of them sets its own object count
+	StressSceneCreateInfo Scene{};
+};
+
+// Frame time distribution, in milliseconds
+struct FrameTimeStats
+{
+	float AverageMs = 0.0f;
+	float P50Ms = 0.0f;
+	float P90Ms = 0.0f;
+	float P99Ms = 0.0f;
+	float MaxMs = 0.0f;
+};
+
+static BenchmarkArguments ParseArguments(int argc, char** argv)
+{
+	BenchmarkArguments args;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "--draws") == 0 && hasValue)
+			args.Draws = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+			args.Frames = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--max-threads") == 0 && hasValue)
+			args.MaxThreads = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--min-objects") == 0 && hasValue)
+			args.MinObjects = std::max((uint32_t)std::stoul(argv[++i]), 1u);
+		else if (strcmp(argv[i], "--max-objects") == 0 && hasValue)
+			args.MaxObjects = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--upload-meshes") == 0 && hasValue)
+			args.UploadMeshes = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--repetitions") == 0 && hasValue)
+			args.Repetitions = std::max((uint32_t)std::stoul(argv[++i]), 1u);
+		else if (strcmp(argv[i], "--output") == 0 && hasValue)
+			args.OutputPath = argv[++i];
+		else if (!StressScene::ParseArgument(argc, argv, i, args.Scene))
+			std::cerr << "Ignoring unknown argument '" << argv[i] << "'\n";
+	}
+
+	if (args.MaxThreads == 0)
+		args.MaxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	args.Frames = std::max(args.Frames, 1u);
+
+	return args;
+}
+
+static float ElapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+static RendererCreateInfo GetHeadlessCreateInfo()
+{
+	RendererCreateInfo createInfo;
+	createInfo.Headless = true;
+	createInfo.Width = 256;
+	createInfo.Height = 256;
+	// Kept apart from the application's cache so the cold runs don't throw it away
+	createInfo.PipelineCachePath = "benchmark_pipeline_cache.bin";
+	return createInfo;
+}
+
+// A handful of meshes so consecutive draws use different ranges of the geometry pool like a real scene would
+static std::vector<VulkanRenderer::MeshHandle> CreateTriangleMeshes(uint32_t count)
+{
+	constexpr Utils::VertexData vertices[] = {
+		{ { -0.01f, -0.01f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+		{ { -0.01f,  0.01f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+		{ {  0.01f,  0.01f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+	};
+
+	constexpr uint32_t indices[] = { 0, 1, 2 };
+
+	std::vector<VulkanRenderer::MeshHandle> meshes;
+	for (uint32_t i = 0; i < count; i++)
+		meshes.push_back(VulkanRenderer::CreateMesh(vertices, (uint32_t)std::size(vertices), indices, (uint32_t)std::size(indices)));
+
+	return meshes;
+}
+
+static FrameTimeStats ComputeFrameTimeStats(std::vector<float> samples)
+{
+	FrameTimeStats stats;
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+
+	auto percentile = [&](float p) { return samples[std::min((size_t)(p * (float)samples.size()), samples.size() - 1)]; };
+
+	float total = 0.0f;
+	for (const float sample : samples)
+		total += sample;
+
+	stats.AverageMs = total / (float)samples.size();
+	stats.P50Ms = percentile(0.50f);
+	stats.P90Ms = percentile(0.90f);
+	stats.P99Ms = percentile(0.99f);
+	stats.MaxMs = samples.back();
+	return stats;
+}
+
+// Deletes the cached SPIR-V of a shader file so the next load compiles it again
+static void ClearShaderCache(const std::string& shaderFilename)
+{
+	const std::filesystem::path cacheDirectory = "shaders/cache/vulkan";
+	if (!std::filesystem::exists(cacheDirectory))
+		return;
+
+	for (const auto& entry : std::filesystem::directory_iterator(cacheDirectory))
+	{
+		if (entry.path().filename().string().rfind(shaderFilename + ".", 0) == 0)
+			std::filesystem::remove(entry.path());
+	}
+}
+
+// GLSL to SPIR-V of the renderer's shaders with and without their cached binaries
+static void MeasureShaders(const BenchmarkArguments& args, JsonWriter& json)
+{
+	struct ShaderSet
+	{
+		const char* Name;
+		std::unordered_map<VulkanShader::ShaderType, std::string> Stages;
+	};
+
+	const ShaderSet shaderSets[] = {
+		{ "Shader", { { VulkanShader::ShaderType::Vertex, "shaders/Shader.vert" }, { VulkanShader::ShaderType::Fragment, "shaders/Shader.frag" } } },
+		{ "Cull", { { VulkanShader::ShaderType::Compute, "shaders/Cull.comp" } } },
+	};
+
+	std::cout << "\nShader compilation, fastest of " << args.Repetitions << " runs\n";
+	std::cout << std::setw(10) << "shader" << std::setw(14) << "cold (ms)" << std::setw(14) << "cached (ms)" << '\n';
+
+	json.BeginArray("shaders");
+
+	for (const ShaderSet& shaderSet : shaderSets)
+	{
+		float coldMs = std::numeric_limits<float>::max();
+		float cachedMs = std::numeric_limits<float>::max();
+
+		for (uint32_t i = 0; i < args.Repetitions; i++)
+		{
+			for (const auto& [type, filepath] : shaderSet.Stages)
+				ClearShaderCache(std::filesystem::path(filepath).filename().string());
+
+			auto start = Clock::now();
+			VulkanShader::CreateFromStages(shaderSet.Name, shaderSet.Stages);
+			coldMs = std::min(coldMs, ElapsedMs(start));
+
+			start = Clock::now();
+			VulkanShader::CreateFromStages(shaderSet.Name, shaderSet.Stages);
+			cachedMs = std::min(cachedMs, ElapsedMs(start));
+		}
+
+		std::cout << std::setw(10) << shaderSet.Name
+			<< std::setw(14) << std::fixed << std::setprecision(3) << coldMs
+			<< std::setw(14) << cachedMs << '\n';
+
+		json.BeginObject();
+		json.Value("name", shaderSet.Name);
+		json.Value("cold_ms", (double)coldMs);
+		json.Value("cached_ms", (double)cachedMs);
+		json.EndObject();
+	}
+
+	json.EndArray();
+}
+
+// Renderer Init with every shader and pipeline compiled from scratch, then with both caches warm
+static bool MeasureInit(const BenchmarkArguments& args, JsonWriter& json)
+{
+	const RendererCreateInfo createInfo = GetHeadlessCreateInfo();
+
+	float coldMs = std::numeric_limits<float>::max();
+	float warmMs = std::numeric_limits<float>::max();
+
+	for (uint32_t i = 0; i < args.Repetitions; i++)
+	{
+		for (const char* shaderFilename : { "Shader.vert", "Shader.frag", "Cull.comp" })
+			ClearShaderCache(shaderFilename);
+		std::filesystem::remove(createInfo.PipelineCachePath);
+
+		for (float* initMs : { &coldMs, &warmMs })
+		{
+			const auto start = Clock::now();
+			if (!VulkanRenderer::Init(createInfo))
+				return false;
+
+			*initMs = std::min(*initMs, ElapsedMs(start));
+			VulkanRenderer::Shutdown();
+		}
+	}
+
+	std::cout << "\nRenderer init, cold " << std::fixed << std::setprecision(3) << coldMs << " ms, cached " << warmMs << " ms\n";
+
+	json.BeginObject("init");
+	json.Value("cold_ms", (double)coldMs);
+	json.Value("cached_ms", (double)warmMs);
+	json.EndObject();
+	return true;
+}
+
+// Mesh creation through the geometry pool and the staging ring until the copies are done on the GPU
+static bool MeasureUpload(const BenchmarkArguments& args, JsonWriter& json)
+{
+	if (!VulkanRenderer::Init(GetHeadlessCreateInfo()))
+		return false;
+
+	const uint32_t vertexCount = args.UploadMeshVertices;
+	const uint32_t indexCount = vertexCount * 3;
+
+	std::vector<Utils::VertexData> vertices(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+		vertices[i] = { { (float)(i % 64) / 64.0f, (float)(i / 64) / 64.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+
+	std::vector<uint32_t> indices(indexCount);
+	for (uint32_t i = 0; i < indexCount; i++)
+		indices[i] = (i * 7) % vertexCount;
+
+	// Everything has to fit in the pool at once, larger requests are clamped instead of failing
+	const RendererCreateInfo createInfo = GetHeadlessCreateInfo();
+	const uint32_t meshCount = std::min({ args.UploadMeshes, createInfo.GeometryVertexCapacity / vertexCount, createInfo.GeometryIndexCapacity / indexCount });
+
+	const uint64_t uploadedBytesBefore = VulkanUploader::GetUploadedBytes();
+	const uint64_t submitsBefore = VulkanUploader::GetSubmitCount();
+
+	const auto start = Clock::now();
+
+	for (uint32_t i = 0; i < meshCount; i++)
+		VulkanRenderer::CreateMesh(vertices.data(), vertexCount, indices.data(), indexCount);
+
+	const float createMs = ElapsedMs(start);
+	VulkanUploader::Wait(VulkanUploader::Flush());
+	const float totalMs = ElapsedMs(start);
+
+	const uint64_t uploadedBytes = VulkanUploader::GetUploadedBytes() - uploadedBytesBefore;
+	const uint64_t submits = VulkanUploader::GetSubmitCount() - submitsBefore;
+	// Too fast to time leaves the rate out rather than dividing by 0
+	const bool hasRate = totalMs > 0.0f;
+	const double megabytesPerSecond = hasRate ? (double)uploadedBytes / (1024.0 * 1024.0) / ((double)totalMs / 1000.0) : 0.0;
+
+	VulkanRenderer::Shutdown();
+
+	std::cout << "\nMesh upload, " << meshCount << " meshes of " << vertexCount << " vertices\n";
+	std::cout << "  " << std::fixed << std::setprecision(2) << (double)uploadedBytes / (1024.0 * 1024.0) << " MB in "
+		<< std::setprecision(3) << totalMs << " ms (" << createMs << " ms creating), ";
+	if (hasRate)
+		std::cout << std::setprecision(1) << megabytesPerSecond << " MB/s, ";
+	std::cout << submits << " submits\n";
+
+	json.BeginObject("upload");
+	json.Value("meshes", meshCount);
+	json.Value("vertices_per_mesh", vertexCount);
+	json.Value("indices_per_mesh", indexCount);
+	json.Value("bytes", uploadedBytes);
+	json.Value("submits", submits);
+	json.Value("create_ms", (double)createMs);
+	json.Value("total_ms", (double)totalMs);
+	if (hasRate)
+		json.Value("megabytes_per_second", megabytesPerSecond);
+	json.EndObject();
+	return true;
+}
+
+// Time spent submitting a static scene and drawing it, the command buffers are only recorded on the first frames
+static bool MeasureSubmission(const BenchmarkArguments& args, JsonWriter& json)
+{
+	if (!VulkanRenderer::Init(GetHeadlessCreateInfo()))
+		return false;
+
+	std::cout << "\nDraw submission, " << args.Frames << " frames\n";
+	std::cout << std::setw(10) << "objects" << std::setw(14) << "submit (ms)" << std::setw(12) << "draw (ms)" << std::setw(16) << "draws/s" << '\n';
+
+	json.BeginArray("submission");
+
+	for (uint32_t objectCount = args.MinObjects; objectCount <= args.MaxObjects; objectCount *= 4)
+	{
+		StressSceneCreateInfo sceneCreateInfo = args.Scene;
+		sceneCreateInfo.ObjectCount = objectCount;
+		const StressScene scene(sceneCreateInfo);
+
+		float submitMs = 0.0f;
+		float drawMs = 0.0f;
+
+		// The first frames in flight record their command buffers, they aren't part of the steady state
+		const uint32_t warmupFrames = VulkanRenderer::GetFramesInFlight();
+
+		for (uint32_t frame = 0; frame < warmupFrames + args.Frames; frame++)
+		{
+			VulkanRenderer::WaitForNextFrame();
+
+			auto start = Clock::now();
+			scene.Submit();
+			const float frameSubmitMs = ElapsedMs(start);
+
+			start = Clock::now();
+			VulkanRenderer::Draw();
+			const float frameDrawMs = ElapsedMs(start);
+
+			if (frame >= warmupFrames)
+			{
+				submitMs += frameSubmitMs;
+				drawMs += frameDrawMs;
+			}
+		}
+
+		submitMs /= (float)args.Frames;
+		drawMs /= (float)args.Frames;
+		const double drawsPerSecond = (double)objectCount / ((double)(submitMs + drawMs) / 1000.0);
+
+		std::cout << std::setw(10) << objectCount
+			<< std::setw(14) << std::fixed << std::setprecision(3) << submitMs
+			<< std::setw(12) << drawMs
+			<< std::setw(16) << std::setprecision(0) << drawsPerSecond << '\n';
+
+		json.BeginObject();
+		json.Value("objects", objectCount);
+		json.Value("submits", scene.GetSubmitCount());
+		json.Value("submit_ms", (double)submitMs);
+		json.Value("draw_ms", (double)drawMs);
+		json.Value("draws_per_second", drawsPerSecond);
+		json.EndObject();
+	}
+
+	json.EndArray();
+
+	VulkanRenderer::Shutdown();
+	return true;
+}
+
+// Average CPU time spent recording a frame of `draws` draw calls with `threadCount` recording threads
+static float MeasureRecording(uint32_t threadCount, const BenchmarkArguments& args)
+{
+	RendererCreateInfo createInfo = GetHeadlessCreateInfo();
+	createInfo.RecordingThreadCount = threadCount;
+
+	if (!VulkanRenderer::Init(createInfo))
+		return -1.0f;
+
+	const std::vector<VulkanRenderer::MeshHandle> meshes = CreateTriangleMeshes(16);
+
+	float totalRecordTimeMs = 0.0f;
+
+	for (uint32_t frame = 0; frame < args.Frames; frame++)
+	{
+		// Rotating the draw list every frame forces it to be recorded again
+		for (uint32_t draw = 0; draw < args.Draws; draw++)
+			VulkanRenderer::Submit(meshes[(draw + frame) % meshes.size()]);
+
+		VulkanRenderer::Draw();
+		totalRecordTimeMs += VulkanRenderer::GetLastRecordTimeMs();
+	}
+
+	VulkanRenderer::Shutdown();
+
+	return totalRecordTimeMs / (float)args.Frames;
+}
+
+static bool MeasureRecordingScaling(const BenchmarkArguments& args, JsonWriter& json)
+{
+	std::cout << "\nCommand recording, " << args.Draws << " draws per frame, " << args.Frames << " frames\n";
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "record (ms)" << std::setw(10) << "speedup" << '\n';
+
+	json.BeginArray("recording");
+
+	float singleThreadedMs = 0.0f;
+
+	for (uint32_t threadCount = 1; threadCount <= args.MaxThreads; threadCount *= 2)
+	{
+		const float recordMs = MeasureRecording(threadCount, args);
+		if (recordMs < 0.0f)
+			return false;
+
+		if (threadCount == 1)
+			singleThreadedMs = recordMs;
+
+		std::cout << std::setw(8) << threadCount
+			<< std::setw(14) << std::fixed << std::setprecision(3) << recordMs
+			<< std::setw(9) << std::setprecision(2) << singleThreadedMs / recordMs << "x\n";
+
+		json.BeginObject();
+		json.Value("threads", threadCount);
+		json.Value("draws", args.Draws);
+		json.Value("record_ms", (double)recordMs);
+		json.EndObject();
+	}
+
+	json.EndArray();
+	return true;
+}
+
+// Wall time of whole frames, waiting, recording and submitting included
+static bool MeasureFrameTimes(const BenchmarkArguments& args, JsonWriter& json)
+{
+	if (!VulkanRenderer::Init(GetHeadlessCreateInfo()))
+		return false;
+
+	StressSceneCreateInfo sceneCreateInfo = args.Scene;
+	sceneCreateInfo.ObjectCount = args.Draws;
+	auto scene = CreateScope<StressScene>(sceneCreateInfo);
+
+	std::vector<float> frameTimes;
+	frameTimes.reserve(args.Frames);
+
+	auto frameStart = Clock::now();
+
+	for (uint32_t frame = 0; frame < args.Frames; frame++)
+	{
+		VulkanRenderer::WaitForNextFrame();
+		scene->Submit();
+		VulkanRenderer::Draw();
+
+		const auto frameEnd = Clock::now();
+		frameTimes.push_back(std::chrono::duration<float, std::milli>(frameEnd - frameStart).count());
+		frameStart = frameEnd;
+	}
+
+	scene.reset();
+	VulkanRenderer::Shutdown();
+
+	const FrameTimeStats stats = ComputeFrameTimeStats(frameTimes);
+
+	std::cout << "\nFrame time, " << args.Draws << " draws per frame, " << args.Frames << " frames\n";
+	std::cout << "  avg " << std::fixed << std::setprecision(3) << stats.AverageMs << " ms, p50 " << stats.P50Ms << " ms, p90 " << stats.P90Ms
+		<< " ms, p99 " << stats.P99Ms << " ms, max " << stats.MaxMs << " ms\n";
+
+	json.BeginObject("frame_time");
+	json.Value("draws", args.Draws);
+	json.Value("frames", args.Frames);
+	json.Value("average_ms", (double)stats.AverageMs);
+	json.Value("p50_ms", (double)stats.P50Ms);
+	json.Value("p90_ms", (double)stats.P90Ms);
+	json.Value("p99_ms", (double)stats.P99Ms);
+	json.Value("max_ms", (double)stats.MaxMs);
+	json.EndObject();
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkArguments args = ParseArguments(argc, argv);
+
+	// Also makes sure a device is available before anything is measured
+	if (!VulkanRenderer::Init(GetHeadlessCreateInfo()))
+	{
+		std::cerr << "Failed to initialize the renderer\n";
+		return -1;
+	}
+
+	const std::string deviceName = VulkanRenderer::GetDeviceName();
+	VulkanRenderer::Shutdown();
+
+	std::cout << "Device: " << deviceName << '\n';
+
+	std::ofstream out(args.OutputPath, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << "Failed to open '" << args.OutputPath << "'\n";
+		return -1;
+	}
+
+	bool succeeded = true;
+	{
+		JsonWriter json(out);
+		json.Value("device", deviceName);
+		json.Value("hardware_threads", std::max(std::thread::hardware_concurrency(), 1u));
+
+		json.BeginObject("scene");
+		json.Value("seed", args.Scene.Seed);
+		json.Value("meshes", args.Scene.MeshCount);
+		json.Value("vertices_per_mesh", args.Scene.VerticesPerMesh);
+		json.Value("materials", args.Scene.MaterialCount);
+		json.Value("overdraw", (double)args.Scene.Overdraw);
+		json.Value("pattern", args.Scene.StateChanges == StateChangePattern::Sorted ? "sorted"
+			: args.Scene.StateChanges == StateChangePattern::Interleaved ? "interleaved" : "random");
+		json.Value("batch_submits", args.Scene.BatchSubmits);
+		json.EndObject();
+
+		MeasureShaders(args, json);
+
+		succeeded = MeasureInit(args, json)
+			&& MeasureUpload(args, json)
+			&& MeasureSubmission(args, json)
+			&& MeasureRecordingScaling(args, json)
+			&& MeasureFrameTimes(args, json);
+	}
+
+	if (!succeeded)
+	{
+		std::cerr << "Failed to initialize the renderer\n";
+		return -1;
+	}
+
+	std::cout << "\nResults written to " << args.OutputPath << '\n';
+	return 0;
+}
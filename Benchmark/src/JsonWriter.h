@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Streams JSON without building a document first. Keys are ignored inside arrays, every value needs one inside objects
+class JsonWriter
+{
+public:
+	JsonWriter(std::ostream& out)
+		: m_Out(out)
+	{
+		m_Out << '{';
+		m_Scopes.push_back({ false, true });
+	}
+
+	JsonWriter(const JsonWriter&) = delete;
+
+	~JsonWriter()
+	{
+		while (!m_Scopes.empty())
+			EndScope();
+
+		m_Out << '\n';
+	}
+
+	void BeginObject(const std::string& key = {}) { BeginValue(key); m_Out << '{'; m_Scopes.push_back({ false, true }); }
+	void EndObject() { EndScope(); }
+	void BeginArray(const std::string& key = {}) { BeginValue(key); m_Out << '['; m_Scopes.push_back({ true, true }); }
+	void EndArray() { EndScope(); }
+
+	void Value(const std::string& key, const std::string& value) { BeginValue(key); WriteString(value); }
+	void Value(const std::string& key, const char* value) { Value(key, std::string(value)); }
+	// JSON has no infinity or NaN, they are written as null
+	void Value(const std::string& key, double value)
+	{
+		BeginValue(key);
+		if (std::isfinite(value))
+			m_Out << value;
+		else
+			m_Out << "null";
+	}
+
+	void Value(const std::string& key, uint64_t value) { BeginValue(key); m_Out << value; }
+	void Value(const std::string& key, uint32_t value) { BeginValue(key); m_Out << value; }
+	void Value(const std::string& key, bool value) { BeginValue(key); m_Out << (value ? "true" : "false"); }
+
+private:
+	struct Scope
+	{
+		bool IsArray;
+		bool Empty;
+	};
+
+	void BeginValue(const std::string& key)
+	{
+		Scope& scope = m_Scopes.back();
+		m_Out << (scope.Empty ? "\n" : ",\n") << std::string(m_Scopes.size() * 2, ' ');
+		scope.Empty = false;
+
+		if (!scope.IsArray)
+		{
+			WriteString(key);
+			m_Out << ": ";
+		}
+	}
+
+	void EndScope()
+	{
+		const Scope scope = m_Scopes.back();
+		m_Scopes.pop_back();
+
+		if (!scope.Empty)
+			m_Out << '\n' << std::string(m_Scopes.size() * 2, ' ');
+
+		m_Out << (scope.IsArray ? ']' : '}');
+	}
+
+	void WriteString(const std::string& str)
+	{
+		m_Out << '"';
+		for (const char c : str)
+		{
+			if (c == '"' || c == '\\')
+				m_Out << '\\';
+			m_Out << c;
+		}
+		m_Out << '"';
+	}
+
+private:
+	std::ostream& m_Out;
+	std::vector<Scope> m_Scopes;
+};
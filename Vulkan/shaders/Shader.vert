@@ -1,12 +1,24 @@
 #version 450 core
 
+// Utils::PackedVertex, expanded to floats by the vertex fetch
 layout(location = 0) in vec3 a_Position;
 layout(location = 1) in vec4 a_Color;
+// Octahedral encoding, nothing is lit yet
+layout(location = 2) in vec2 a_Normal;
+
+// Per instance attributes, a mat4 takes up four locations
+layout(location = 3) in mat4 a_InstanceTransform;
+layout(location = 7) in vec4 a_InstanceColor;
+
+layout(push_constant) uniform Camera
+{
+	mat4 ViewProjection;
+} u_Camera;
 
 layout(location = 0) out vec4 v_Color;
 
 void main()
 {
-	v_Color = a_Color;
-	gl_Position = vec4(a_Position, 1.0);
+	v_Color = a_Color * a_InstanceColor;
+	gl_Position = u_Camera.ViewProjection * a_InstanceTransform * vec4(a_Position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "ClusterCulling.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CLUSTER_CULLING_SSE2
+	#include <emmintrin.h>
+#endif
+
+void ClusterBounds::Add(const Meshlet& meshlet, uint32_t baseIndex)
+{
+	CenterX.push_back(meshlet.BoundingSphere.x);
+	CenterY.push_back(meshlet.BoundingSphere.y);
+	CenterZ.push_back(meshlet.BoundingSphere.z);
+	Radius.push_back(meshlet.BoundingSphere.w);
+	AxisX.push_back(meshlet.ConeAxis.x);
+	AxisY.push_back(meshlet.ConeAxis.y);
+	AxisZ.push_back(meshlet.ConeAxis.z);
+	Cutoff.push_back(meshlet.ConeCutoff);
+	FirstIndex.push_back(baseIndex + meshlet.FirstIndex);
+	IndexCount.push_back(meshlet.IndexCount);
+}
+
+namespace Utils
+{
+	// What the clusters are tested against, moved into the mesh's space so the clusters themselves don't have to be transformed
+	struct LocalCullingView
+	{
+		glm::vec4 Planes[6];
+		// Length of the planes' normals. Under non uniform scale a sphere becomes an ellipsoid and this is how far it reaches towards the plane
+		float PlaneScales[6];
+		bool CullBackfaces;
+		// The camera is infinitely far away, Camera is the normalized direction towards it
+		bool Orthographic;
+		glm::vec3 Camera;
+		// -1 when the camera's homogeneous w is positive, the cone has to point the other way for its triangles to face away
+		float AxisSign;
+	};
+
+	static float Determinant3(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		return glm::dot(a, glm::cross(b, c));
+	}
+
+	glm::vec4 GetHomogeneousCamera(const glm::mat4& viewProjection)
+	{
+		glm::vec4 rows[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const int row = i < 2 ? i : 3;
+			rows[i] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+		}
+
+		// Cofactors along a fourth row, dot(camera, p) is the determinant of the x, y and w rows followed by p
+		glm::vec4 camera;
+		for (int column = 0; column < 4; column++)
+		{
+			glm::vec3 minor[3];
+			for (int i = 0; i < 3; i++)
+			{
+				int k = 0;
+				for (int j = 0; j < 4; j++)
+				{
+					if (j != column)
+						minor[i][k++] = rows[i][j];
+				}
+			}
+
+			const float sign = (column & 1) == 0 ? -1.0f : 1.0f;
+			camera[column] = sign * Determinant3(minor[0], minor[1], minor[2]);
+		}
+
+		return camera;
+	}
+
+	static bool IsClusterVisible(const ClusterBounds& clusters, uint32_t i, const LocalCullingView& view)
+	{
+		const float x = clusters.CenterX[i];
+		const float y = clusters.CenterY[i];
+		const float z = clusters.CenterZ[i];
+		const float radius = clusters.Radius[i];
+
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = view.Planes[p];
+			const float distance = ((plane.x * x + plane.y * y) + plane.z * z) + plane.w;
+			if (distance < -(radius * view.PlaneScales[p]))
+				return false;
+		}
+
+		if (!view.CullBackfaces)
+			return true;
+
+		const float axisX = clusters.AxisX[i];
+		const float axisY = clusters.AxisY[i];
+		const float axisZ = clusters.AxisZ[i];
+
+		if (view.Orthographic)
+			return !(((axisX * view.Camera.x + axisY * view.Camera.y) + axisZ * view.Camera.z) > clusters.Cutoff[i]);
+
+		// Every normal in the cone points away from the camera for every point in the sphere
+		const float toCenterX = x - view.Camera.x;
+		const float toCenterY = y - view.Camera.y;
+		const float toCenterZ = z - view.Camera.z;
+		const float distance = std::sqrt((toCenterX * toCenterX + toCenterY * toCenterY) + toCenterZ * toCenterZ);
+		const float coneDot = ((toCenterX * axisX + toCenterY * axisY) + toCenterZ * axisZ) * view.AxisSign;
+		return !(coneDot >= clusters.Cutoff[i] * distance + radius);
+	}
+
+	uint32_t CullClusters(const ClusterBounds& clusters, const glm::mat4& transform, const glm::vec4 frustumPlanes[6], const glm::vec4& camera,
+		bool cullBackfaces, uint8_t* outVisible)
+	{
+		const uint32_t count = clusters.GetCount();
+
+		// A flattened mesh can't be brought into its own space, it's drawn whole
+		const float determinant = glm::determinant(transform);
+		if (determinant == 0.0f)
+		{
+			for (uint32_t i = 0; i < count; i++)
+				outVisible[i] = 1;
+
+			return count;
+		}
+
+		LocalCullingView view;
+		const glm::mat4 transposed = glm::transpose(transform);
+		for (int p = 0; p < 6; p++)
+		{
+			view.Planes[p] = transposed * frustumPlanes[p];
+			view.PlaneScales[p] = glm::length(glm::vec3(view.Planes[p]));
+		}
+
+		// A mirroring transform flips the winding of every triangle
+		const glm::vec4 localCamera = glm::inverse(transform) * camera * (determinant < 0.0f ? -1.0f : 1.0f);
+		const glm::vec3 cameraDirection = glm::vec3(localCamera);
+
+		view.CullBackfaces = cullBackfaces;
+		view.Orthographic = std::abs(localCamera.w) <= 1e-6f * glm::length(cameraDirection);
+		view.Camera = view.Orthographic ? glm::normalize(cameraDirection) : cameraDirection / localCamera.w;
+		view.AxisSign = localCamera.w < 0.0f ? 1.0f : -1.0f;
+
+		uint32_t i = 0;
+		uint32_t visibleCount = 0;
+
+#ifdef CLUSTER_CULLING_SSE2
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(&clusters.CenterX[i]);
+			const __m128 y = _mm_loadu_ps(&clusters.CenterY[i]);
+			const __m128 z = _mm_loadu_ps(&clusters.CenterZ[i]);
+			const __m128 radius = _mm_loadu_ps(&clusters.Radius[i]);
+
+			// Same operations in the same order as IsClusterVisible
+			__m128 culled = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const glm::vec4& plane = view.Planes[p];
+				__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y));
+				distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z)), _mm_set1_ps(plane.w));
+
+				const __m128 reach = _mm_sub_ps(zero, _mm_mul_ps(radius, _mm_set1_ps(view.PlaneScales[p])));
+				culled = _mm_or_ps(culled, _mm_cmplt_ps(distance, reach));
+			}
+
+			if (view.CullBackfaces)
+			{
+				const __m128 axisX = _mm_loadu_ps(&clusters.AxisX[i]);
+				const __m128 axisY = _mm_loadu_ps(&clusters.AxisY[i]);
+				const __m128 axisZ = _mm_loadu_ps(&clusters.AxisZ[i]);
+				const __m128 cutoff = _mm_loadu_ps(&clusters.Cutoff[i]);
+
+				if (view.Orthographic)
+				{
+					__m128 coneDot = _mm_add_ps(_mm_mul_ps(axisX, _mm_set1_ps(view.Camera.x)), _mm_mul_ps(axisY, _mm_set1_ps(view.Camera.y)));
+					coneDot = _mm_add_ps(coneDot, _mm_mul_ps(axisZ, _mm_set1_ps(view.Camera.z)));
+					culled = _mm_or_ps(culled, _mm_cmpgt_ps(coneDot, cutoff));
+				}
+				else
+				{
+					const __m128 toCenterX = _mm_sub_ps(x, _mm_set1_ps(view.Camera.x));
+					const __m128 toCenterY = _mm_sub_ps(y, _mm_set1_ps(view.Camera.y));
+					const __m128 toCenterZ = _mm_sub_ps(z, _mm_set1_ps(view.Camera.z));
+
+					__m128 distance = _mm_add_ps(_mm_mul_ps(toCenterX, toCenterX), _mm_mul_ps(toCenterY, toCenterY));
+					distance = _mm_sqrt_ps(_mm_add_ps(distance, _mm_mul_ps(toCenterZ, toCenterZ)));
+
+					__m128 coneDot = _mm_add_ps(_mm_mul_ps(toCenterX, axisX), _mm_mul_ps(toCenterY, axisY));
+					coneDot = _mm_mul_ps(_mm_add_ps(coneDot, _mm_mul_ps(toCenterZ, axisZ)), _mm_set1_ps(view.AxisSign));
+
+					culled = _mm_or_ps(culled, _mm_cmpge_ps(coneDot, _mm_add_ps(_mm_mul_ps(cutoff, distance), radius)));
+				}
+			}
+
+			const int culledMask = _mm_movemask_ps(culled);
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				outVisible[i + lane] = (culledMask >> lane) & 1 ? 0 : 1;
+				visibleCount += outVisible[i + lane];
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			outVisible[i] = IsClusterVisible(clusters, i, view) ? 1 : 0;
+			visibleCount += outVisible[i];
+		}
+
+		return visibleCount;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "MeshletBuilder.h"
+
+#include <vector>
+
+// Meshlet bounds of a mesh, one array per component so Utils::CullClusters tests four meshlets at once
+struct ClusterBounds
+{
+	std::vector<float> CenterX, CenterY, CenterZ, Radius;
+	std::vector<float> AxisX, AxisY, AxisZ, Cutoff;
+	// Relative to the start of the index buffer, consecutive clusters are consecutive ranges
+	std::vector<uint32_t> FirstIndex;
+	std::vector<uint32_t> IndexCount;
+
+	uint32_t GetCount() const { return (uint32_t)FirstIndex.size(); }
+	void Add(const Meshlet& meshlet, uint32_t baseIndex);
+};
+
+namespace Utils
+{
+	// The point every clip space x, y and w is 0 at, so the camera as a homogeneous point. w is 0 for orthographic projections.
+	// A triangle is back facing for VK_FRONT_FACE_CLOCKWISE when the camera is on the positive side of its plane
+	glm::vec4 GetHomogeneousCamera(const glm::mat4& viewProjection);
+
+	// Writes 0 for every cluster that is outside the frustum or faces away from the camera as a whole and 1 for the rest, returns how many are visible.
+	// The planes are normalized world space ones pointing into the frustum, camera comes from GetHomogeneousCamera and is negated for
+	// VK_FRONT_FACE_COUNTER_CLOCKWISE. Uses SSE2 where it's available, the scalar fallback gives the same results
+	uint32_t CullClusters(const ClusterBounds& clusters, const glm::mat4& transform, const glm::vec4 frustumPlanes[6], const glm::vec4& camera,
+		bool cullBackfaces, uint8_t* outVisible);
+}
@@ -0,0 +1,99 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+// Sleeps are cut short by this much and the rest is spun, it covers the default timer resolution on Windows
+static constexpr auto SPIN_THRESHOLD = std::chrono::microseconds(2000);
+// Weight of the newest sample in the expected work time
+static constexpr float WORK_SMOOTHING = 0.1f;
+// Extra time just in time pacing leaves for the frame, a late frame costs a whole refresh
+static constexpr float WORK_MARGIN = 1.2f;
+
+FramePacer::FramePacer(const FramePacerCreateInfo& createInfo)
+	: m_JustInTime(createInfo.JustInTime)
+{
+	if (createInfo.TargetFrameRate > 0.0f)
+		m_FramePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / createInfo.TargetFrameRate));
+}
+
+void FramePacer::WaitForNextFrame(uint64_t frameId)
+{
+	const auto waitStart = Clock::now();
+
+	if (m_FramePeriod != Clock::duration::zero())
+	{
+		auto deadline = m_NextDeadline;
+		if (m_JustInTime)
+			deadline -= std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(m_ExpectedWorkMs * WORK_MARGIN));
+
+		SleepUntil(deadline);
+
+		// A frame that ran late starts a new cadence instead of rushing the next ones to catch up
+		m_NextDeadline = std::max(m_NextDeadline + m_FramePeriod, Clock::now());
+	}
+
+	m_FrameStart = Clock::now();
+	m_TotalWaitMs += std::chrono::duration<double, std::milli>(m_FrameStart - waitStart).count();
+
+	// A frame that was skipped before it could be submitted starts again with the same id, its latency counts from the retry
+	if (!m_PendingFrames.empty() && m_PendingFrames.back().FrameId == frameId)
+	{
+		m_PendingFrames.back().StartTime = m_FrameStart;
+		return;
+	}
+
+	m_PendingFrames.push_back({ frameId, m_FrameStart });
+
+	if (m_Stats.FrameCount > 0)
+		m_TotalFrameMs += std::chrono::duration<double, std::milli>(m_FrameStart - m_LastFrameStart).count();
+
+	m_LastFrameStart = m_FrameStart;
+	m_Stats.FrameCount++;
+}
+
+void FramePacer::EndFrame()
+{
+	const float workMs = std::chrono::duration<float, std::milli>(Clock::now() - m_FrameStart).count();
+	m_ExpectedWorkMs = m_Stats.FrameCount == 1 ? workMs : m_ExpectedWorkMs + (workMs - m_ExpectedWorkMs) * WORK_SMOOTHING;
+}
+
+void FramePacer::CompleteFrames(uint64_t frameId)
+{
+	const auto now = Clock::now();
+
+	while (!m_PendingFrames.empty() && m_PendingFrames.front().FrameId <= frameId)
+	{
+		const float latencyMs = std::chrono::duration<float, std::milli>(now - m_PendingFrames.front().StartTime).count();
+		m_PendingFrames.pop_front();
+
+		m_TotalLatencyMs += latencyMs;
+		m_Stats.MaxLatencyMs = std::max(m_Stats.MaxLatencyMs, latencyMs);
+		m_CompletedCount++;
+	}
+}
+
+FrameLatencyStats FramePacer::GetStats() const
+{
+	FrameLatencyStats stats = m_Stats;
+
+	if (stats.FrameCount > 1)
+		stats.AverageFrameMs = (float)(m_TotalFrameMs / (double)(stats.FrameCount - 1));
+
+	if (stats.FrameCount > 0)
+		stats.AverageWaitMs = (float)(m_TotalWaitMs / (double)stats.FrameCount);
+
+	if (m_CompletedCount > 0)
+		stats.AverageLatencyMs = (float)(m_TotalLatencyMs / (double)m_CompletedCount);
+
+	return stats;
+}
+
+void FramePacer::SleepUntil(Clock::time_point deadline)
+{
+	if (Clock::now() + SPIN_THRESHOLD < deadline)
+		std::this_thread::sleep_until(deadline - SPIN_THRESHOLD);
+
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+}
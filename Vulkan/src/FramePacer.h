@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+struct FramePacerCreateInfo
+{
+	// Frames per second the loop is limited to, 0 leaves it to the present mode
+	float TargetFrameRate = 0.0f;
+	// Delays the wait by the expected CPU time of a frame so it finishes right at the deadline instead of starting there,
+	// input is then sampled as late as possible
+	bool JustInTime = false;
+};
+
+struct FrameLatencyStats
+{
+	uint64_t FrameCount = 0;
+	// Between consecutive frames starting
+	float AverageFrameMs = 0.0f;
+	// Spent blocked in WaitForNextFrame
+	float AverageWaitMs = 0.0f;
+	// From WaitForNextFrame returning, which is when input is sampled, until the frame completed
+	float AverageLatencyMs = 0.0f;
+	float MaxLatencyMs = 0.0f;
+	// Completion is the frame being presented, otherwise it's the GPU finishing it
+	bool MeasuredToPresent = false;
+};
+
+// Limits the frame rate and measures input to display latency. Sleeps until shortly before a deadline and spins the rest,
+// sleeping alone overshoots by the scheduler's granularity.
+class FramePacer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+public:
+	FramePacer(const FramePacerCreateInfo& createInfo);
+	FramePacer(const FramePacer&) = delete;
+
+	// Blocks until the frame should start and marks it as started, frameId has to increase every frame.
+	// Calling it again with the same id restarts that frame instead of counting a new one
+	void WaitForNextFrame(uint64_t frameId);
+	// The CPU is done with the frame, how long it took is what just in time pacing waits less by
+	void EndFrame();
+	// Every frame up to frameId has completed
+	void CompleteFrames(uint64_t frameId);
+
+	// 0 when no frame is waiting to complete
+	uint64_t GetOldestPendingFrame() const { return m_PendingFrames.empty() ? 0 : m_PendingFrames.front().FrameId; }
+
+	void SetMeasuredToPresent(bool measuredToPresent) { m_Stats.MeasuredToPresent = measuredToPresent; }
+	FrameLatencyStats GetStats() const;
+
+private:
+	static void SleepUntil(Clock::time_point deadline);
+
+private:
+	struct PendingFrame
+	{
+		uint64_t FrameId;
+		Clock::time_point StartTime;
+	};
+
+	Clock::duration m_FramePeriod{};
+	bool m_JustInTime = false;
+
+	Clock::time_point m_NextDeadline{};
+	Clock::time_point m_FrameStart{};
+	Clock::time_point m_LastFrameStart{};
+	// Smoothed CPU time from a frame starting until EndFrame
+	float m_ExpectedWorkMs = 0.0f;
+
+	std::deque<PendingFrame> m_PendingFrames;
+
+	FrameLatencyStats m_Stats;
+	double m_TotalFrameMs = 0.0;
+	double m_TotalWaitMs = 0.0;
+	double m_TotalLatencyMs = 0.0;
+	uint64_t m_CompletedCount = 0;
+};
@@ -1,9 +1,105 @@
 #include "Window.h"
 #include "VulkanRenderer.h"
+#include "Profiler.h"
+#include "StressScene.h"
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+
+struct AppArguments
+{
+	bool Headless = false;
+	bool GpuDriven = false;
+	bool OptimizeMeshes = false;
+	bool GenerateLods = false;
+	bool BuildMeshlets = false;
+	uint32_t Width = 800;
+	uint32_t Height = 600;
+	uint32_t Frames = 1;
+	// When set, the first mesh is also drawn this many times in a grid with a single instanced draw
+	uint32_t Instances = 0;
+	std::string OutputPath = "frame.ppm";
+
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	float TargetFrameRate = 0.0f;
+	bool JustInTimePacing = false;
+
+	// Chrome trace of the CPU zones, written on exit when set
+	std::string TracePath;
+	// Frames between stats dumps, 0 only prints them on exit
+	uint32_t StatsInterval = 0;
+
+	// Any --scene-* option replaces the two quads with a generated scene
+	bool UseStressScene = false;
+	StressSceneCreateInfo StressScene{};
+};
+
+static VkPresentModeKHR ParsePresentMode(const std::string& name)
+{
+	if (name == "immediate")
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	if (name == "mailbox")
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	if (name == "fifo-relaxed")
+		return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+	if (name != "fifo")
+		std::cerr << "Unknown present mode '" << name << "', using fifo\n";
+
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static AppArguments ParseArguments(int argc, char** argv)
+{
+	AppArguments args;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "--headless") == 0)
+			args.Headless = true;
+		else if (strcmp(argv[i], "--gpu-driven") == 0)
+			args.GpuDriven = true;
+		else if (strcmp(argv[i], "--optimize-meshes") == 0)
+			args.OptimizeMeshes = true;
+		else if (strcmp(argv[i], "--lods") == 0)
+			args.GenerateLods = true;
+		else if (strcmp(argv[i], "--meshlets") == 0)
+			args.BuildMeshlets = true;
+		else if (strcmp(argv[i], "--width") == 0 && hasValue)
+			args.Width = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--height") == 0 && hasValue)
+			args.Height = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+			args.Frames = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--instances") == 0 && hasValue)
+			args.Instances = (uint32_t)std::stoul(argv[++i]);
+		else if (strcmp(argv[i], "--output") == 0 && hasValue)
+			args.OutputPath = argv[++i];
+		else if (strcmp(argv[i], "--present-mode") == 0 && hasValue)
+			args.PresentMode = ParsePresentMode(argv[++i]);
+		else if (strcmp(argv[i], "--fps") == 0 && hasValue)
+			args.TargetFrameRate = std::stof(argv[++i]);
+		else if (strcmp(argv[i], "--jit") == 0)
+			args.JustInTimePacing = true;
+		else if (strcmp(argv[i], "--trace") == 0 && hasValue)
+			args.TracePath = argv[++i];
+		else if (strcmp(argv[i], "--stats-interval") == 0 && hasValue)
+			args.StatsInterval = (uint32_t)std::stoul(argv[++i]);
+		else if (StressScene::ParseArgument(argc, argv, i, args.StressScene))
+			args.UseStressScene = true;
+		else
+			std::cerr << "Ignoring unknown argument '" << argv[i] << "'\n";
+	}
+
+	return args;
+}
 
 static bool InitGLFW()
 {
@@ -11,27 +107,252 @@ static bool InitGLFW()
 		return false;
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	return true;
+}
+
+static std::vector<VulkanRenderer::MeshHandle> CreateScene()
+{
+	constexpr Utils::VertexData meshVertices[] = {
+		{ { -0.1f, -0.4f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+		{ { -0.1f,  0.4f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+		{ { -0.9f,  0.4f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+		{ { -0.9f, -0.4f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+	};
+
+	constexpr Utils::VertexData meshVertices2[] = {
+		{ {  0.9f, -0.3f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+		{ {  0.9f,  0.3f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+		{ {  0.1f,  0.3f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+		{ {  0.1f, -0.3f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+	};
+
+	constexpr uint32_t meshIndices[] = {
+		0, 1, 2,
+		2, 3, 0
+	};
+
+	return {
+		VulkanRenderer::CreateMesh(meshVertices, (uint32_t)std::size(meshVertices), meshIndices, (uint32_t)std::size(meshIndices)),
+		VulkanRenderer::CreateMesh(meshVertices2, (uint32_t)std::size(meshVertices2), meshIndices, (uint32_t)std::size(meshIndices))
+	};
+}
+
+// Scales the instances down and spreads them over the whole screen
+static std::vector<Utils::InstanceData> CreateInstanceGrid(uint32_t count)
+{
+	std::vector<Utils::InstanceData> instances(count);
+
+	const uint32_t columns = std::max((uint32_t)std::ceil(std::sqrt((float)count)), 1u);
+	const float cellSize = 2.0f / (float)columns;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t column = i % columns;
+		const uint32_t row = i / columns;
+
+		glm::mat4 transform(1.0f);
+		transform[0][0] = cellSize;
+		transform[1][1] = cellSize;
+		transform[3] = glm::vec4(-1.0f + cellSize * ((float)column + 1.0f), -1.0f + cellSize * ((float)row + 0.5f), 0.0f, 1.0f);
+
+		instances[i].Transform = transform;
+		instances[i].Color = glm::vec4((float)column / (float)columns, (float)row / (float)columns, 1.0f, 1.0f);
+	}
+
+	return instances;
+}
+
+static void SubmitScene(const std::vector<VulkanRenderer::MeshHandle>& scene, const std::vector<Utils::InstanceData>& instances, const StressScene* stressScene)
+{
+	if (stressScene != nullptr)
+		stressScene->Submit();
+	else
+	{
+		for (const auto mesh : scene)
+			VulkanRenderer::Submit(mesh);
+	}
+
+	if (!instances.empty())
+		VulkanRenderer::SubmitInstanced(scene[0], instances.data(), (uint32_t)instances.size());
+}
+
+static void PrintStats()
+{
+	const RendererStats stats = VulkanRenderer::GetStats();
+	const FrameCounters& frame = stats.LastFrame;
+	const FrameLatencyStats& latency = stats.Latency;
+
+	std::cout << "Frame " << stats.FrameNumber << ": " << frame.Commands.DrawCalls << " draws, " << frame.Commands.DispatchCalls << " dispatches, "
+		<< frame.Commands.PipelineBinds << " pipeline binds, " << frame.Commands.BufferBinds << " buffer binds, "
+		<< frame.UploadedBytes << " bytes uploaded, " << frame.GpuWaitMs << " ms waiting on the GPU, " << frame.RecordMs << " ms recording\n";
+
+	if (frame.ClustersTested > 0)
+		std::cout << "Meshlets: " << frame.ClustersCulled << " of " << frame.ClustersTested << " culled\n";
+
+	if (stats.PipelineStatisticsAvailable)
+	{
+		const PipelineStatistics& pipeline = stats.LastPipelineStatistics;
+		std::cout << "Pipeline: " << pipeline.InputAssemblyVertices << " vertices, " << pipeline.InputAssemblyPrimitives << " primitives, "
+			<< pipeline.VertexShaderInvocations << " vertex invocations, " << pipeline.ClippingInvocations << " clipped, "
+			<< pipeline.ClippingPrimitives << " after clipping, " << pipeline.FragmentShaderInvocations << " fragment invocations\n";
+	}
+
+	for (const auto& zone : stats.GpuZones)
+	{
+		std::cout << "GPU " << zone.Name << ": " << zone.AverageMs << " ms average, " << zone.MinMs << " ms min, "
+			<< zone.P99Ms << " ms p99 over " << zone.SampleCount << " frames\n";
+	}
+
+	std::cout << latency.FrameCount << " frames, " << latency.AverageFrameMs << " ms per frame, " << latency.AverageWaitMs << " ms paced\n";
+	std::cout << "Latency to " << (latency.MeasuredToPresent ? "present" : "GPU completion") << ": "
+		<< latency.AverageLatencyMs << " ms average, " << latency.MaxLatencyMs << " ms max\n";
+
+	std::cout << "Pipelines: " << stats.GraphicsPipelineCount << " graphics, " << stats.PipelineCacheHits << " cache hits, "
+		<< stats.PipelineCacheMisses << " misses, " << stats.PipelineCompile.CompiledCount << " compiled in the background\n";
+
+	for (size_t i = 0; i < stats.Heaps.size(); i++)
+	{
+		const VulkanHeapStats& heap = stats.Heaps[i];
+		if (heap.AllocatedBytes == 0)
+			continue;
+
+		std::cout << "Heap " << i << ": " << heap.UsedBytes << " used, " << heap.AllocatedBytes << " allocated, "
+			<< heap.WastedBytes << " wasted in " << heap.AllocationCount << " allocations\n";
+	}
+
+	const MeshOptimizationStats& optimization = stats.MeshOptimization;
+	if (optimization.MeshCount > 0)
+	{
+		std::cout << "Meshes optimized: " << optimization.MeshCount << ", ACMR " << optimization.GetAcmrBefore() << " -> " << optimization.GetAcmrAfter()
+			<< ", ATVR " << optimization.GetAtvrBefore() << " -> " << optimization.GetAtvrAfter() << ", "
+			<< optimization.VertexCountBefore << " -> " << optimization.VertexCountAfter << " vertices\n";
+	}
+}
+
+static bool WritePPM(const std::string& filepath, const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height)
+{
+	std::ofstream out(filepath, std::ios::out | std::ios::binary);
+	if (!out.is_open())
+		return false;
+
+	out << "P6\n" << width << ' ' << height << "\n255\n";
+
+	// Pixels come back as RGBA8, PPM only stores RGB
+	for (size_t i = 0; i < (size_t)width * height; i++)
+		out.write((const char*)&pixels[i * 4], 3);
+
 	return true;
 }
 
-int main()
+static int RunHeadless(const AppArguments& args)
+{
+	RendererCreateInfo createInfo;
+	createInfo.Headless = true;
+	createInfo.Width = args.Width;
+	createInfo.Height = args.Height;
+	createInfo.GpuDriven = args.GpuDriven;
+	createInfo.OptimizeMeshes = args.OptimizeMeshes;
+	createInfo.GenerateLods = args.GenerateLods;
+	createInfo.BuildMeshlets = args.BuildMeshlets;
+
+	if (!VulkanRenderer::Init(createInfo))
+		return -1;
+
+	const auto scene = CreateScene();
+	const auto instances = CreateInstanceGrid(args.Instances);
+	Scope<StressScene> stressScene = args.UseStressScene ? CreateScope<StressScene>(args.StressScene) : nullptr;
+
+	for (uint32_t i = 0; i < args.Frames; i++)
+	{
+		SubmitScene(scene, instances, stressScene.get());
+		VulkanRenderer::Draw();
+
+		if (args.StatsInterval > 0 && (i + 1) % args.StatsInterval == 0)
+			PrintStats();
+	}
+
+	std::vector<uint8_t> pixels;
+	uint32_t width, height;
+	VulkanRenderer::ReadFrame(pixels, width, height);
+
+	PrintStats();
+	stressScene.reset();
+	VulkanRenderer::Shutdown();
+
+	if (!WritePPM(args.OutputPath, pixels, width, height))
+	{
+		std::cerr << "Failed to write frame to '" << args.OutputPath << "'\n";
+		return -1;
+	}
+
+	return 0;
+}
+
+static int RunWindowed(const AppArguments& args)
 {
 	if (!InitGLFW())
 		return -1;
 
-	Ref<Window> window = Window::Create("Vulkan", 800, 600);
-	
-	if (!VulkanRenderer::Init(window))
+	Ref<Window> window = Window::Create("Vulkan", args.Width, args.Height);
+
+	RendererCreateInfo createInfo;
+	createInfo.Window = window;
+	createInfo.GpuDriven = args.GpuDriven;
+	createInfo.OptimizeMeshes = args.OptimizeMeshes;
+	createInfo.GenerateLods = args.GenerateLods;
+	createInfo.BuildMeshlets = args.BuildMeshlets;
+	createInfo.PresentMode = args.PresentMode;
+	createInfo.TargetFrameRate = args.TargetFrameRate;
+	createInfo.JustInTimePacing = args.JustInTimePacing;
+
+	if (!VulkanRenderer::Init(createInfo))
 		return -1;
 
+	const auto scene = CreateScene();
+	const auto instances = CreateInstanceGrid(args.Instances);
+	Scope<StressScene> stressScene = args.UseStressScene ? CreateScope<StressScene>(args.StressScene) : nullptr;
+	uint32_t framesSinceStats = 0;
+
 	while (!glfwWindowShouldClose(window->GetGLFWWindow()))
 	{
+		// Input is sampled after the pacing wait so it's as recent as possible when the frame is drawn
+		VulkanRenderer::WaitForNextFrame();
 		glfwPollEvents();
+		SubmitScene(scene, instances, stressScene.get());
 		VulkanRenderer::Draw();
+
+		if (args.StatsInterval > 0 && ++framesSinceStats == args.StatsInterval)
+		{
+			PrintStats();
+			framesSinceStats = 0;
+		}
 	}
 
+	PrintStats();
+	stressScene.reset();
 	VulkanRenderer::Shutdown();
 
 	return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv)
+{
+	const AppArguments args = ParseArguments(argc, argv);
+
+	if (!args.TracePath.empty())
+	{
+		PROFILE_THREAD_NAME("Main");
+		Profiler::SetEnabled(true);
+	}
+
+	const int result = args.Headless ? RunHeadless(args) : RunWindowed(args);
+
+	if (!args.TracePath.empty() && !Profiler::WriteChromeTrace(args.TracePath))
+	{
+		std::cerr << "Failed to write trace '" << args.TracePath << "'\n";
+		return -1;
+	}
+
+	return result;
+}
@@ -0,0 +1,372 @@
+#include "MeshOptimizer.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+// FIFO cache modeled with timestamps, a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since it was added.
+// Returns the number of misses of the triangle
+static uint32_t UpdateCache(const uint32_t* triangle, std::vector<uint32_t>& cacheTimestamps, uint32_t& timestamp)
+{
+	uint32_t misses = 0;
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		if (timestamp - cacheTimestamps[triangle[i]] > MeshOptimizer::VERTEX_CACHE_SIZE)
+		{
+			cacheTimestamps[triangle[i]] = timestamp++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+static uint64_t HashVertex(const Utils::VertexData& vertex)
+{
+	// FNV-1a over the bits, equal vertices are the ones with equal bits
+	uint8_t bytes[sizeof(Utils::VertexData)];
+	memcpy(bytes, &vertex, sizeof(bytes));
+
+	uint64_t hash = 14695981039346656037ull;
+	for (const uint8_t byte : bytes)
+		hash = (hash ^ byte) * 1099511628211ull;
+
+	return hash;
+}
+
+void MeshOptimizationStats::Add(const MeshOptimizationStats& other)
+{
+	MeshCount += other.MeshCount;
+	TriangleCount += other.TriangleCount;
+	VertexCountBefore += other.VertexCountBefore;
+	VertexCountAfter += other.VertexCountAfter;
+	WeldedVertexCount += other.WeldedVertexCount;
+	TransformsBefore += other.TransformsBefore;
+	TransformsAfter += other.TransformsAfter;
+}
+
+MeshOptimizationStats MeshOptimizer::Optimize(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, const MeshOptimizerSettings& settings)
+{
+	PROFILE_FUNCTION();
+
+	if (indices.size() % 3 != 0)
+		throw std::runtime_error("Only triangle lists can be optimized!");
+
+	MeshOptimizationStats stats;
+	stats.MeshCount = 1;
+	stats.TriangleCount = indices.size() / 3;
+	stats.VertexCountBefore = vertices.size();
+	stats.TransformsBefore = CountTransforms(indices, (uint32_t)vertices.size());
+
+	if (settings.WeldVertices)
+		WeldVertices(vertices, indices);
+
+	stats.WeldedVertexCount = vertices.size();
+
+	if (settings.OptimizeVertexCache)
+		OptimizeVertexCache(indices, (uint32_t)vertices.size());
+
+	// Works on the clusters the cache optimization leaves behind
+	if (settings.OptimizeOverdraw)
+		OptimizeOverdraw(indices, vertices, settings.OverdrawThreshold);
+
+	// Last since it depends on the final triangle order
+	if (settings.OptimizeVertexFetch)
+		OptimizeVertexFetch(vertices, indices);
+
+	stats.VertexCountAfter = vertices.size();
+	stats.TransformsAfter = CountTransforms(indices, (uint32_t)vertices.size());
+	return stats;
+}
+
+uint32_t MeshOptimizer::WeldVertices(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices)
+{
+	PROFILE_FUNCTION();
+
+	const uint32_t vertexCount = (uint32_t)vertices.size();
+
+	// Open addressing with linear probing, at most half full
+	uint32_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+
+	std::vector<uint32_t> table(tableSize, INVALID_INDEX);
+	std::vector<uint32_t> remap(vertexCount);
+	uint32_t uniqueCount = 0;
+
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		uint32_t slot = (uint32_t)HashVertex(vertices[i]) & (tableSize - 1);
+
+		while (table[slot] != INVALID_INDEX && memcmp(&vertices[table[slot]], &vertices[i], sizeof(Utils::VertexData)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		// Unique vertices are compacted in place, the table points at their new position
+		if (table[slot] == INVALID_INDEX)
+		{
+			vertices[uniqueCount] = vertices[i];
+			table[slot] = uniqueCount++;
+		}
+
+		remap[i] = table[slot];
+	}
+
+	for (uint32_t& index : indices)
+		index = remap[index];
+
+	vertices.resize(uniqueCount);
+	return vertexCount - uniqueCount;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	PROFILE_FUNCTION();
+
+	const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of every vertex, packed one vertex after the other
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (const uint32_t index : indices)
+		adjacencyOffsets[index + 1]++;
+
+	std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < (uint32_t)indices.size(); i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	// Triangles not emitted yet that use the vertex
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEndStack;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+	uint32_t cursor = 0;
+	uint32_t fanningVertex = 0;
+
+	while (fanningVertex != INVALID_INDEX)
+	{
+		candidates.clear();
+
+		// Emits every remaining triangle around the fanning vertex
+		for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++)
+		{
+			const uint32_t triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				deadEndStack.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (timestamp - cacheTimestamps[vertex] > VERTEX_CACHE_SIZE)
+					cacheTimestamps[vertex] = timestamp++;
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// The next fan is around the candidate that will still be cached after emitting all of its triangles, the oldest one of those
+		fanningVertex = INVALID_INDEX;
+		int32_t bestPriority = -1;
+
+		for (const uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int32_t priority = 0;
+			if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+				priority = (int32_t)(timestamp - cacheTimestamps[vertex]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanningVertex = vertex;
+			}
+		}
+
+		// Dead end, backtrack to the most recent vertex with triangles left or continue with the next unprocessed one
+		while (fanningVertex == INVALID_INDEX && !deadEndStack.empty())
+		{
+			const uint32_t vertex = deadEndStack.back();
+			deadEndStack.pop_back();
+
+			if (liveTriangles[vertex] > 0)
+				fanningVertex = vertex;
+		}
+
+		while (fanningVertex == INVALID_INDEX && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				fanningVertex = cursor;
+
+			cursor++;
+		}
+	}
+
+	indices = std::move(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Utils::VertexData>& vertices, float threshold)
+{
+	PROFILE_FUNCTION();
+
+	const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+	uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+
+	// Hard boundaries are where the cache optimization started a disjoint patch, the triangle misses all of its vertices
+	std::vector<uint32_t> hardBoundaries;
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		if (UpdateCache(&indices[i * 3], cacheTimestamps, timestamp) == 3 || i == 0)
+			hardBoundaries.push_back(i);
+	}
+
+	// Patches are split further as soon as the part so far is within the threshold of the patch's ACMR,
+	// flushing the cache at the split costs at most that much
+	std::vector<uint32_t> clusters;
+	for (size_t patch = 0; patch < hardBoundaries.size(); patch++)
+	{
+		const uint32_t start = hardBoundaries[patch];
+		const uint32_t end = patch + 1 < hardBoundaries.size() ? hardBoundaries[patch + 1] : triangleCount;
+
+		timestamp += VERTEX_CACHE_SIZE + 1;
+		uint32_t patchMisses = 0;
+		for (uint32_t i = start; i < end; i++)
+			patchMisses += UpdateCache(&indices[i * 3], cacheTimestamps, timestamp);
+
+		const float clusterThreshold = threshold * (float)patchMisses / (float)(end - start);
+
+		clusters.push_back(start);
+		timestamp += VERTEX_CACHE_SIZE + 1;
+
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+
+		for (uint32_t i = start; i < end; i++)
+		{
+			runningMisses += UpdateCache(&indices[i * 3], cacheTimestamps, timestamp);
+			runningTriangles++;
+
+			if ((float)runningMisses / (float)runningTriangles <= clusterThreshold && i + 1 < end)
+			{
+				clusters.push_back(i + 1);
+				timestamp += VERTEX_CACHE_SIZE + 1;
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+	}
+
+	glm::vec3 meshCentroid(0.0f);
+	for (const uint32_t index : indices)
+		meshCentroid += vertices[index].Position;
+	meshCentroid /= (float)indices.size();
+
+	// Clusters far out and facing away from the center are likely to occlude the rest, they are drawn first
+	std::vector<float> sortKeys(clusters.size());
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+	{
+		const uint32_t start = clusters[cluster];
+		const uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+
+		float area = 0.0f;
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+
+		for (uint32_t i = start; i < end; i++)
+		{
+			const glm::vec3& p0 = vertices[indices[i * 3 + 0]].Position;
+			const glm::vec3& p1 = vertices[indices[i * 3 + 1]].Position;
+			const glm::vec3& p2 = vertices[indices[i * 3 + 2]].Position;
+
+			const glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+			const float triangleArea = glm::length(triangleNormal);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		centroid = area > 0.0f ? centroid / area : centroid;
+		const float normalLength = glm::length(normal);
+		normal = normalLength > 0.0f ? normal / normalLength : normal;
+
+		sortKeys[cluster] = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::vector<uint32_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	for (const uint32_t cluster : order)
+	{
+		const uint32_t start = clusters[cluster];
+		const uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+		result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+	}
+
+	indices = std::move(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+	std::vector<Utils::VertexData> result;
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == INVALID_INDEX)
+		{
+			remap[index] = (uint32_t)result.size();
+			result.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(result);
+}
+
+uint64_t MeshOptimizer::CountTransforms(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+
+	uint64_t transforms = 0;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		transforms += UpdateCache(&indices[i], cacheTimestamps, timestamp);
+
+	return transforms;
+}
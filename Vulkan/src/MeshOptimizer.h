@@ -0,0 +1,68 @@
+#pragma once
+
+#include "VulkanUtils.h"
+
+#include <vector>
+
+struct MeshOptimizerSettings
+{
+	// Merges vertices whose attributes are bit for bit identical
+	bool WeldVertices = true;
+	bool OptimizeVertexCache = true;
+	// Orders the triangle clusters so the ones facing outwards are drawn first, which only pays off with depth testing.
+	// Reorders the triangles, so overlapping blended ones may come out different
+	bool OptimizeOverdraw = true;
+	// Cache efficiency the clusters can lose to get smaller, 1.05 allows 5% more transforms
+	float OverdrawThreshold = 1.05f;
+	bool OptimizeVertexFetch = true;
+};
+
+// Additive so the stats of several meshes can be summed
+struct MeshOptimizationStats
+{
+	uint32_t MeshCount = 0;
+	uint64_t TriangleCount = 0;
+	uint64_t VertexCountBefore = 0;
+	// Welding and the fetch reordering drop duplicated and unreferenced vertices
+	uint64_t VertexCountAfter = 0;
+	// After welding, duplicates would make the unoptimized order look better than it is per vertex
+	uint64_t WeldedVertexCount = 0;
+	// Vertex shader invocations with a FIFO post transform cache of MeshOptimizer::VERTEX_CACHE_SIZE entries
+	uint64_t TransformsBefore = 0;
+	uint64_t TransformsAfter = 0;
+
+	// Average transforms per triangle, 0.5 is the best a regular grid can do and 3 the worst
+	float GetAcmrBefore() const { return TriangleCount > 0 ? (float)TransformsBefore / (float)TriangleCount : 0.0f; }
+	float GetAcmrAfter() const { return TriangleCount > 0 ? (float)TransformsAfter / (float)TriangleCount : 0.0f; }
+	// Average transforms per vertex, 1 means every vertex is transformed exactly once
+	float GetAtvrBefore() const { return WeldedVertexCount > 0 ? (float)TransformsBefore / (float)WeldedVertexCount : 0.0f; }
+	float GetAtvrAfter() const { return VertexCountAfter > 0 ? (float)TransformsAfter / (float)VertexCountAfter : 0.0f; }
+
+	void Add(const MeshOptimizationStats& other);
+};
+
+// Reorders a triangle list before it's uploaded so the vertex shader runs fewer times, based on
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab and Barczak).
+// Every pass keeps the triangles and their winding, only their order and the vertex numbering change
+class MeshOptimizer
+{
+public:
+	// Entries of the modeled post transform cache, the same on every GPU isn't possible so this is a typical size
+	static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+public:
+	// Runs the enabled passes in the order they depend on each other
+	static MeshOptimizationStats Optimize(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, const MeshOptimizerSettings& settings = {});
+
+	// Returns how many vertices were removed, the indices are remapped to the remaining ones
+	static uint32_t WeldVertices(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices);
+	// Tipsify, linear in the number of triangles
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+	// Expects indices already optimized for the vertex cache, they are split into clusters that are sorted by how much they face outwards
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Utils::VertexData>& vertices, float threshold);
+	// Numbers the vertices in the order they are first used and drops the unreferenced ones
+	static void OptimizeVertexFetch(std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices);
+
+	// Vertex shader invocations the indices cause with the modeled cache
+	static uint64_t CountTransforms(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+};
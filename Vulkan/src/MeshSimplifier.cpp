@@ -0,0 +1,434 @@
+#include "MeshSimplifier.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+// Planes through the border edges count this much more than the faces so open edges keep their outline
+static constexpr double BORDER_WEIGHT = 10.0;
+
+// Every pass removes at most the triangles that are left to remove, the collapses in a pass are independent so they can't be reconsidered
+static constexpr uint32_t MAX_SIMPLIFY_PASSES = 100;
+
+enum class VertexKind
+{
+	Manifold,
+	// On exactly one open edge loop, only moves along it
+	Border,
+	// Never moves, other vertices can still collapse onto it
+	Locked
+};
+
+// Sum of the squared distances to a set of planes, weighted by the area they came from
+struct Quadric
+{
+	double A00 = 0.0, A11 = 0.0, A22 = 0.0, A01 = 0.0, A02 = 0.0, A12 = 0.0;
+	double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+	double C = 0.0;
+	double Weight = 0.0;
+
+	void AddPlane(const glm::vec3& normal, float distance, double weight)
+	{
+		A00 += weight * normal.x * normal.x;
+		A11 += weight * normal.y * normal.y;
+		A22 += weight * normal.z * normal.z;
+		A01 += weight * normal.x * normal.y;
+		A02 += weight * normal.x * normal.z;
+		A12 += weight * normal.y * normal.z;
+		B0 += weight * distance * normal.x;
+		B1 += weight * distance * normal.y;
+		B2 += weight * distance * normal.z;
+		C += weight * distance * distance;
+		Weight += weight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		A00 += other.A00; A11 += other.A11; A22 += other.A22;
+		A01 += other.A01; A02 += other.A02; A12 += other.A12;
+		B0 += other.B0; B1 += other.B1; B2 += other.B2;
+		C += other.C;
+		Weight += other.Weight;
+	}
+
+	// Weighted average of the squared distances
+	double Evaluate(const glm::vec3& point) const
+	{
+		if (Weight <= 0.0)
+			return 0.0;
+
+		const double x = point.x, y = point.y, z = point.z;
+		const double rx = A00 * x + A01 * y + A02 * z;
+		const double ry = A01 * x + A11 * y + A12 * z;
+		const double rz = A02 * x + A12 * y + A22 * z;
+		const double error = rx * x + ry * y + rz * z + 2.0 * (B0 * x + B1 * y + B2 * z) + C;
+		return std::max(error, 0.0) / Weight;
+	}
+};
+
+struct Collapse
+{
+	uint32_t Source;
+	uint32_t Target;
+	double Error;
+};
+
+// Directed edges between the position representatives, open ones have no opposite
+struct EdgeTopology
+{
+	std::unordered_map<uint64_t, uint32_t> EdgeCounts;
+
+	uint32_t GetCount(uint32_t from, uint32_t to) const
+	{
+		const auto it = EdgeCounts.find(((uint64_t)from << 32) | to);
+		return it != EdgeCounts.end() ? it->second : 0;
+	}
+};
+
+static EdgeTopology BuildEdges(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionRemap)
+{
+	EdgeTopology topology;
+	topology.EdgeCounts.reserve(indices.size());
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t from = positionRemap[indices[i + corner]];
+			const uint32_t to = positionRemap[indices[i + (corner + 1) % 3]];
+			topology.EdgeCounts[((uint64_t)from << 32) | to]++;
+		}
+	}
+
+	return topology;
+}
+
+static void ClassifyVertices(const std::vector<uint32_t>& positionRemap, const std::vector<bool>& sharedPosition,
+	const EdgeTopology& topology, std::vector<VertexKind>& outKinds, std::vector<uint32_t>& outBorderNext, std::vector<uint32_t>& outBorderPrevious)
+{
+	const uint32_t vertexCount = (uint32_t)positionRemap.size();
+	std::vector<uint32_t> openOut(vertexCount, 0);
+	std::vector<uint32_t> openIn(vertexCount, 0);
+	std::vector<bool> nonManifold(vertexCount, false);
+
+	outBorderNext.assign(vertexCount, UINT32_MAX);
+	outBorderPrevious.assign(vertexCount, UINT32_MAX);
+
+	for (const auto& [key, count] : topology.EdgeCounts)
+	{
+		const uint32_t from = (uint32_t)(key >> 32);
+		const uint32_t to = (uint32_t)key;
+
+		if (count > 1)
+		{
+			nonManifold[from] = true;
+			nonManifold[to] = true;
+		}
+
+		if (topology.GetCount(to, from) == 0)
+		{
+			openOut[from]++;
+			openIn[to]++;
+			outBorderNext[from] = to;
+			outBorderPrevious[to] = from;
+		}
+	}
+
+	outKinds.assign(vertexCount, VertexKind::Manifold);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (sharedPosition[v] || nonManifold[v] || openOut[v] > 1 || openIn[v] != openOut[v])
+			outKinds[v] = VertexKind::Locked;
+		else if (openOut[v] == 1)
+			outKinds[v] = VertexKind::Border;
+	}
+}
+
+static bool CanCollapse(uint32_t source, uint32_t target, const std::vector<VertexKind>& kinds, const std::vector<bool>& sharedPosition,
+	const std::vector<uint32_t>& borderNext, const std::vector<uint32_t>& borderPrevious)
+{
+	// Collapsing onto a seam would have to pick one of the vertices at its position
+	if (sharedPosition[target])
+		return false;
+
+	if (kinds[source] == VertexKind::Manifold)
+		return true;
+
+	return kinds[source] == VertexKind::Border && (borderNext[source] == target || borderPrevious[source] == target);
+}
+
+// Whether moving source onto target turns any of its other triangles around or flattens them into a line
+static bool HasFlips(uint32_t source, uint32_t target, const std::vector<Utils::VertexData>& vertices, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& positionRemap, const uint32_t* triangles, uint32_t triangleCount)
+{
+	const glm::vec3& targetPosition = vertices[target].Position;
+
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		const uint32_t* triangle = &indices[triangles[i] * 3];
+		if (positionRemap[triangle[0]] == target || positionRemap[triangle[1]] == target || positionRemap[triangle[2]] == target)
+			continue;
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			before[corner] = vertices[triangle[corner]].Position;
+			after[corner] = positionRemap[triangle[corner]] == source ? targetPosition : before[corner];
+		}
+
+		const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<Utils::VertexData>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+	float maxError, float& outError)
+{
+	PROFILE_FUNCTION();
+
+	outError = 0.0f;
+	std::vector<uint32_t> result = indices;
+	const uint32_t vertexCount = (uint32_t)vertices.size();
+
+	// Vertices with the same position are one vertex to the topology, the first of them represents the rest
+	std::vector<uint32_t> sortedVertices(vertexCount);
+	std::iota(sortedVertices.begin(), sortedVertices.end(), 0);
+	std::sort(sortedVertices.begin(), sortedVertices.end(), [&](uint32_t a, uint32_t b)
+	{
+		return memcmp(&vertices[a].Position, &vertices[b].Position, sizeof(glm::vec3)) < 0;
+	});
+
+	std::vector<uint32_t> positionRemap(vertexCount);
+	std::vector<bool> sharedPosition(vertexCount, false);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		const uint32_t vertex = sortedVertices[i];
+		if (i > 0 && memcmp(&vertices[vertex].Position, &vertices[sortedVertices[i - 1]].Position, sizeof(glm::vec3)) == 0)
+		{
+			positionRemap[vertex] = positionRemap[sortedVertices[i - 1]];
+			sharedPosition[positionRemap[vertex]] = true;
+		}
+		else
+			positionRemap[vertex] = vertex;
+	}
+
+	std::vector<VertexKind> kinds;
+	std::vector<uint32_t> borderNext;
+	std::vector<uint32_t> borderPrevious;
+	EdgeTopology topology = BuildEdges(result, positionRemap);
+	ClassifyVertices(positionRemap, sharedPosition, topology, kinds, borderNext, borderPrevious);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::vec3& p0 = vertices[result[i + 0]].Position;
+		const glm::vec3& p1 = vertices[result[i + 1]].Position;
+		const glm::vec3& p2 = vertices[result[i + 2]].Position;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float doubleArea = glm::length(normal);
+		if (doubleArea == 0.0f)
+			continue;
+
+		normal = normal / doubleArea;
+		for (uint32_t corner = 0; corner < 3; corner++)
+			quadrics[positionRemap[result[i + corner]]].AddPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+
+		// A plane perpendicular to the face keeps border vertices on the line of the edge
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t from = positionRemap[result[i + corner]];
+			const uint32_t to = positionRemap[result[i + (corner + 1) % 3]];
+			if (topology.GetCount(to, from) != 0)
+				continue;
+
+			const glm::vec3 edge = vertices[to].Position - vertices[from].Position;
+			const float edgeLength = glm::length(edge);
+			if (edgeLength == 0.0f)
+				continue;
+
+			const glm::vec3 borderNormal = glm::cross(edge, normal) / edgeLength;
+			const double weight = BORDER_WEIGHT * edgeLength * edgeLength;
+			quadrics[from].AddPlane(borderNormal, -glm::dot(borderNormal, vertices[from].Position), weight);
+			quadrics[to].AddPlane(borderNormal, -glm::dot(borderNormal, vertices[from].Position), weight);
+		}
+	}
+
+	const double maxErrorSquared = (double)maxError * (double)maxError;
+	double resultError = 0.0;
+
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<bool> collapseLocked(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+
+	for (uint32_t pass = 0; pass < MAX_SIMPLIFY_PASSES && result.size() > targetIndexCount; pass++)
+	{
+		if (pass > 0)
+		{
+			topology = BuildEdges(result, positionRemap);
+			ClassifyVertices(positionRemap, sharedPosition, topology, kinds, borderNext, borderPrevious);
+		}
+
+		// Every edge once, in the cheaper direction that is allowed
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a = positionRemap[result[i + corner]];
+				const uint32_t b = positionRemap[result[i + (corner + 1) % 3]];
+				if (a > b && topology.GetCount(b, a) != 0)
+					continue;
+
+				const bool aToB = CanCollapse(a, b, kinds, sharedPosition, borderNext, borderPrevious);
+				const bool bToA = CanCollapse(b, a, kinds, sharedPosition, borderNext, borderPrevious);
+				if (!aToB && !bToA)
+					continue;
+
+				const double errorAToB = aToB ? quadrics[a].Evaluate(vertices[b].Position) : DBL_MAX;
+				const double errorBToA = bToA ? quadrics[b].Evaluate(vertices[a].Position) : DBL_MAX;
+				collapses.push_back(errorAToB <= errorBToA ? Collapse{ a, b, errorAToB } : Collapse{ b, a, errorBToA });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+		// Triangles around every vertex, valid for the whole pass since the neighbours of a collapse are locked
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (const uint32_t index : result)
+			adjacencyOffsets[positionRemap[index] + 1]++;
+
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < (uint32_t)result.size(); i++)
+			adjacency[fill[positionRemap[result[i]]]++] = i / 3;
+
+		std::iota(collapseRemap.begin(), collapseRemap.end(), 0);
+		std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+
+		// Interior collapses remove two triangles and border ones one
+		const uint32_t trianglesToRemove = (uint32_t)(result.size() - targetIndexCount + 2) / 3;
+		uint32_t trianglesRemoved = 0;
+		uint32_t collapseCount = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.Error > maxErrorSquared || trianglesRemoved >= trianglesToRemove)
+				break;
+
+			if (collapseLocked[collapse.Source] || collapseLocked[collapse.Target])
+				continue;
+
+			const uint32_t* triangles = &adjacency[adjacencyOffsets[collapse.Source]];
+			const uint32_t triangleCount = adjacencyOffsets[collapse.Source + 1] - adjacencyOffsets[collapse.Source];
+			if (HasFlips(collapse.Source, collapse.Target, vertices, result, positionRemap, triangles, triangleCount))
+				continue;
+
+			for (uint32_t i = 0; i < triangleCount; i++)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+					collapseLocked[positionRemap[result[triangles[i] * 3 + corner]]] = true;
+			}
+
+			collapseRemap[collapse.Source] = collapse.Target;
+			quadrics[collapse.Target].Add(quadrics[collapse.Source]);
+			resultError = std::max(resultError, collapse.Error);
+
+			trianglesRemoved += kinds[collapse.Source] == VertexKind::Border ? 1 : 2;
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Sources and targets never share their position, so they are their own representatives and can be remapped directly
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const uint32_t v0 = collapseRemap[result[i + 0]];
+			const uint32_t v1 = collapseRemap[result[i + 1]];
+			const uint32_t v2 = collapseRemap[result[i + 2]];
+
+			const uint32_t p0 = positionRemap[v0];
+			const uint32_t p1 = positionRemap[v1];
+			const uint32_t p2 = positionRemap[v2];
+			if (p0 == p1 || p1 == p2 || p2 == p0)
+				continue;
+
+			result[writeIndex++] = v0;
+			result[writeIndex++] = v1;
+			result[writeIndex++] = v2;
+		}
+
+		result.resize(writeIndex);
+	}
+
+	outError = (float)std::sqrt(resultError);
+	return result;
+}
+
+std::vector<MeshLod> MeshSimplifier::GenerateLods(const std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, const MeshLodSettings& settings)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<MeshLod> lods = { { 0, (uint32_t)indices.size(), 0.0f } };
+	if (vertices.empty() || indices.empty())
+		return lods;
+
+	// Same bounding sphere as VulkanMesh, the errors are relative to its radius
+	glm::vec3 min = vertices[0].Position;
+	glm::vec3 max = vertices[0].Position;
+	for (const auto& vertex : vertices)
+	{
+		min = glm::min(min, vertex.Position);
+		max = glm::max(max, vertex.Position);
+	}
+
+	const glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (const auto& vertex : vertices)
+		radius = std::max(radius, glm::length(vertex.Position - center));
+
+	if (radius == 0.0f)
+		return lods;
+
+	std::vector<uint32_t> current = indices;
+	float error = 0.0f;
+
+	while (lods.size() < std::min(settings.MaxLodCount, Utils::MAX_MESH_LODS))
+	{
+		const uint32_t targetIndexCount = (uint32_t)((float)(current.size() / 3) * settings.ReductionRatio) * 3;
+		const float remainingError = settings.MaxError * radius - error;
+		if (targetIndexCount == 0 || remainingError <= 0.0f)
+			break;
+
+		// Every level is simplified from the one before, adding the errors bounds the distance to the full mesh
+		float levelError;
+		std::vector<uint32_t> simplified = Simplify(vertices, current, targetIndexCount, remainingError, levelError);
+
+		// A level that barely removes anything costs memory without saving triangles
+		if (simplified.empty() || simplified.size() * 10 > current.size() * 9)
+			break;
+
+		error += levelError;
+		lods.push_back({ (uint32_t)indices.size(), (uint32_t)simplified.size(), error / radius });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		current = std::move(simplified);
+	}
+
+	return lods;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "VulkanUtils.h"
+
+#include <vector>
+
+// A range of a mesh's indices that draws the whole mesh at some level of detail
+struct MeshLod
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	// Largest distance to the full mesh, relative to its bounding radius so it scales with the object
+	float Error = 0.0f;
+};
+
+struct MeshLodSettings
+{
+	// Every level aims for this fraction of the previous level's triangles
+	float ReductionRatio = 0.5f;
+	// Relative to the bounding radius, no level is generated past it
+	float MaxError = 0.05f;
+	uint32_t MaxLodCount = Utils::MAX_MESH_LODS;
+};
+
+// Quadric error metric simplification, "Surface Simplification Using Quadric Error Metrics" (Garland and Heckbert).
+// Edges are collapsed onto one of their vertices so every level shares the mesh's vertices and only needs its own indices.
+// Borders only collapse along themselves and vertices whose position is shared by several vertices never move, so
+// attribute seams and open edges keep their shape
+class MeshSimplifier
+{
+public:
+	// Collapses the cheapest edges until the indices are down to targetIndexCount or the next collapse would move the surface
+	// further than maxError. outError is the largest error of the collapses that were done, in the units of the positions
+	static std::vector<uint32_t> Simplify(const std::vector<Utils::VertexData>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+		float maxError, float& outError);
+
+	// The first level is the mesh itself, every other one is simplified from the one before and appended to indices
+	static std::vector<MeshLod> GenerateLods(const std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, const MeshLodSettings& settings = {});
+};
@@ -0,0 +1,191 @@
+#include "MeshletBuilder.h"
+
+#include "VertexPacking.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+// Cones whose normals get closer than this to perpendicular to the axis are too wide to be culled
+static constexpr float MIN_CONE_DOT = 0.1f;
+
+// Positions as the GPU sees them after packing, so the bounds match what is drawn like VulkanMesh's do
+static glm::vec3 GetRoundedPosition(const Utils::VertexData& vertex)
+{
+	return glm::vec3(
+		Utils::HalfToFloat(Utils::FloatToHalf(vertex.Position.x)),
+		Utils::HalfToFloat(Utils::FloatToHalf(vertex.Position.y)),
+		Utils::HalfToFloat(Utils::FloatToHalf(vertex.Position.z)));
+}
+
+static void ComputeBounds(const std::vector<Utils::VertexData>& vertices, const uint32_t* indices, uint32_t indexCount, Meshlet& outMeshlet)
+{
+	glm::vec3 min = GetRoundedPosition(vertices[indices[0]]);
+	glm::vec3 max = min;
+	for (uint32_t i = 1; i < indexCount; i++)
+	{
+		const glm::vec3 position = GetRoundedPosition(vertices[indices[i]]);
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+
+	const glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t i = 0; i < indexCount; i++)
+		radius = std::max(radius, glm::length(GetRoundedPosition(vertices[indices[i]]) - center));
+
+	outMeshlet.BoundingSphere = glm::vec4(center, radius);
+
+	// The axis is the average of the unit normals, the cone has to reach the one furthest from it
+	std::vector<glm::vec3> normals;
+	normals.reserve(indexCount / 3);
+	glm::vec3 axis(0.0f);
+
+	for (uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3 p0 = GetRoundedPosition(vertices[indices[i + 0]]);
+		const glm::vec3 p1 = GetRoundedPosition(vertices[indices[i + 1]]);
+		const glm::vec3 p2 = GetRoundedPosition(vertices[indices[i + 2]]);
+
+		const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float length = glm::length(normal);
+
+		// Degenerate triangles are never rasterized, they can face anywhere
+		if (length == 0.0f)
+			continue;
+
+		normals.push_back(normal / length);
+		axis += normals.back();
+	}
+
+	const float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return;
+
+	axis = axis / axisLength;
+	float minDot = 1.0f;
+	for (const glm::vec3& normal : normals)
+		minDot = std::min(minDot, glm::dot(axis, normal));
+
+	outMeshlet.ConeAxis = axis;
+	outMeshlet.ConeCutoff = minDot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+
+std::vector<Meshlet> MeshletBuilder::Build(const std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount)
+{
+	PROFILE_FUNCTION();
+
+	const uint32_t triangleCount = indexCount / 3;
+	const uint32_t vertexCount = (uint32_t)vertices.size();
+	const uint32_t* triangles = &indices[firstIndex];
+
+	std::vector<Meshlet> meshlets;
+	if (triangleCount == 0)
+		return meshlets;
+
+	// Triangles of every vertex, packed one vertex after the other
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[triangles[i] + 1]++;
+
+	std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[triangles[i]]++] = i / 3;
+
+	std::vector<bool> emitted(triangleCount, false);
+	// Index of the meshlet a vertex was last added to
+	std::vector<uint32_t> vertexMeshlet(vertexCount, INVALID_INDEX);
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	uint32_t cursor = 0;
+	while (true)
+	{
+		while (cursor < triangleCount && emitted[cursor])
+			cursor++;
+
+		if (cursor == triangleCount)
+			break;
+
+		const uint32_t meshletIndex = (uint32_t)meshlets.size();
+		const uint32_t meshletStart = (uint32_t)result.size();
+		uint32_t meshletVertexCount = 0;
+		uint32_t meshletTriangleCount = 0;
+
+		candidates.clear();
+		uint32_t next = cursor;
+
+		while (next != INVALID_INDEX)
+		{
+			emitted[next] = true;
+			meshletTriangleCount++;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = triangles[next * 3 + corner];
+				result.push_back(vertex);
+
+				if (vertexMeshlet[vertex] == meshletIndex)
+					continue;
+
+				vertexMeshlet[vertex] = meshletIndex;
+				meshletVertexCount++;
+
+				for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++)
+				{
+					if (!emitted[adjacency[i]])
+						candidates.push_back(adjacency[i]);
+				}
+			}
+
+			if (meshletTriangleCount == MAX_TRIANGLES)
+				break;
+
+			// The candidate adding the fewest vertices, one that adds none can't be beaten
+			next = INVALID_INDEX;
+			uint32_t bestNewVertices = 4;
+
+			for (size_t i = 0; i < candidates.size();)
+			{
+				const uint32_t triangle = candidates[i];
+				if (emitted[triangle])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				uint32_t newVertices = 0;
+				for (uint32_t corner = 0; corner < 3; corner++)
+					newVertices += vertexMeshlet[triangles[triangle * 3 + corner]] != meshletIndex ? 1 : 0;
+
+				if (newVertices < bestNewVertices && meshletVertexCount + newVertices <= MAX_VERTICES)
+				{
+					next = triangle;
+					bestNewVertices = newVertices;
+					if (newVertices == 0)
+						break;
+				}
+
+				i++;
+			}
+		}
+
+		Meshlet meshlet;
+		meshlet.FirstIndex = firstIndex + meshletStart;
+		meshlet.IndexCount = (uint32_t)result.size() - meshletStart;
+		ComputeBounds(vertices, &result[meshletStart], meshlet.IndexCount, meshlet);
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin() + firstIndex);
+	return meshlets;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "VulkanUtils.h"
+
+#include <vector>
+
+// A cluster of neighbouring triangles drawn from a contiguous range of the mesh's indices
+struct Meshlet
+{
+	// xyz is the center and w the radius
+	glm::vec4 BoundingSphere{};
+	// Every triangle's normal is within the cone around the axis. The cutoff is the sine of its half angle,
+	// 1 when the cone is too wide for the meshlet to ever be facing away as a whole
+	glm::vec3 ConeAxis{};
+	float ConeCutoff = 1.0f;
+	// Relative to the start of the mesh's indices
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+};
+
+class MeshletBuilder
+{
+public:
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+public:
+	// Reorders the triangles in [firstIndex, firstIndex + indexCount) so every meshlet is a contiguous range of them.
+	// Meshlets grow over the triangles that add the fewest new vertices, a new one is started once none fits
+	static std::vector<Meshlet> Build(const std::vector<Utils::VertexData>& vertices, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount);
+};
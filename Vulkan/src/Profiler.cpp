@@ -0,0 +1,138 @@
+#include "Profiler.h"
+
+#include "Base.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+// Zones kept per thread, older ones are overwritten
+static constexpr uint64_t ZONES_PER_THREAD = 64 * 1024;
+
+struct RecordedZone
+{
+	const char* Name;
+	int64_t StartNs;
+	int64_t EndNs;
+};
+
+struct ThreadBuffer
+{
+	uint32_t ThreadId = 0;
+	std::string Name;
+	// Empty until the thread records its first zone, threads that are only named cost next to nothing
+	std::vector<RecordedZone> Zones;
+	// Only the owning thread writes, the release store publishes the zone it just wrote
+	std::atomic<uint64_t> WriteIndex = 0;
+};
+
+static const auto s_StartTime = std::chrono::steady_clock::now();
+
+// Buffers outlive their threads so a trace written after the workers stopped still has their zones
+static std::mutex s_ThreadsMutex;
+static std::vector<Scope<ThreadBuffer>> s_Threads;
+static thread_local ThreadBuffer* s_ThreadBuffer = nullptr;
+
+static ThreadBuffer& GetThreadBuffer()
+{
+	if (s_ThreadBuffer == nullptr)
+	{
+		std::lock_guard lock(s_ThreadsMutex);
+		auto& buffer = s_Threads.emplace_back(CreateScope<ThreadBuffer>());
+		buffer->ThreadId = (uint32_t)s_Threads.size();
+		s_ThreadBuffer = buffer.get();
+	}
+
+	return *s_ThreadBuffer;
+}
+
+static void WriteJsonString(std::ostream& out, const char* str)
+{
+	out << '"';
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			out << '\\';
+		out << *str;
+	}
+	out << '"';
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard lock(s_ThreadsMutex);
+	buffer.Name = name;
+}
+
+int64_t Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_StartTime).count();
+}
+
+void Profiler::RecordZone(const char* name, int64_t startNs, int64_t endNs)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	// Only reached while enabled, ProfileZone checks before timing anything. The trace reads Zones under the same lock
+	if (buffer.Zones.empty())
+	{
+		std::lock_guard lock(s_ThreadsMutex);
+		buffer.Zones.resize(ZONES_PER_THREAD);
+	}
+
+	const uint64_t index = buffer.WriteIndex.load(std::memory_order_relaxed);
+	buffer.Zones[index % ZONES_PER_THREAD] = { name, startNs, endNs };
+	buffer.WriteIndex.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filepath)
+{
+	std::ofstream out(filepath, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	// Chrome traces are in microseconds
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool firstEvent = true;
+	auto beginEvent = [&]()
+	{
+		out << (firstEvent ? "\n" : ",\n");
+		firstEvent = false;
+	};
+
+	std::lock_guard lock(s_ThreadsMutex);
+
+	for (const auto& buffer : s_Threads)
+	{
+		if (!buffer->Name.empty())
+		{
+			beginEvent();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->ThreadId << ",\"args\":{\"name\":";
+			WriteJsonString(out, buffer->Name.c_str());
+			out << "}}";
+		}
+
+		const uint64_t writeIndex = buffer->WriteIndex.load(std::memory_order_acquire);
+		const uint64_t zoneCount = std::min(writeIndex, ZONES_PER_THREAD);
+
+		for (uint64_t i = writeIndex - zoneCount; i < writeIndex; i++)
+		{
+			const RecordedZone& zone = buffer->Zones[i % ZONES_PER_THREAD];
+
+			beginEvent();
+			out << "{\"name\":";
+			WriteJsonString(out, zone.Name);
+			out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->ThreadId
+				<< ",\"ts\":" << (double)zone.StartNs / 1000.0 << ",\"dur\":" << (double)(zone.EndNs - zone.StartNs) / 1000.0 << "}";
+		}
+	}
+
+	out << "\n]}\n";
+	return out.good();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Records named CPU zones into a ring buffer per thread and exports them as a Chrome trace (chrome://tracing or Perfetto).
+// Recording takes no locks, only the first zone of a thread registers its buffer. While disabled a zone is a single relaxed load.
+// Zone names have to outlive the profiler, string literals and __FUNCTION__ are what the macros pass.
+class Profiler
+{
+public:
+	static void SetEnabled(bool enabled) { s_Enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+	// Shown as the thread's name in the trace. Only registers the thread, its zone buffer is allocated by the first zone it records
+	static void SetThreadName(const std::string& name);
+
+	// Nanoseconds since the profiler was loaded
+	static int64_t Now();
+	static void RecordZone(const char* name, int64_t startNs, int64_t endNs);
+
+	// Zones still being recorded while it runs may come out torn, write it once the threads are idle
+	static bool WriteChromeTrace(const std::string& filepath);
+
+private:
+	static inline std::atomic<bool> s_Enabled = false;
+};
+
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name)
+		: m_Name(Profiler::IsEnabled() ? name : nullptr)
+	{
+		if (m_Name != nullptr)
+			m_Start = Profiler::Now();
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+
+	~ProfileZone()
+	{
+		if (m_Name != nullptr)
+			Profiler::RecordZone(m_Name, m_Start, Profiler::Now());
+	}
+
+private:
+	const char* m_Name;
+	int64_t m_Start = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Defining VULKAN_NO_PROFILING strips the zones out entirely
+#ifndef VULKAN_NO_PROFILING
+	#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+	#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_THREAD_NAME(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
@@ -0,0 +1,222 @@
+#include "StressScene.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// SplitMix64. The standard distributions aren't specified exactly, with them a seed could generate different scenes on different platforms
+class SceneRandom
+{
+public:
+	SceneRandom(uint64_t seed)
+		: m_State(seed) {}
+
+	uint64_t Next()
+	{
+		uint64_t z = (m_State += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// In [min, max)
+	float Range(float min, float max)
+	{
+		const float unit = (float)(Next() >> 40) / (float)(1u << 24);
+		return min + (max - min) * unit;
+	}
+
+	uint32_t Index(uint32_t count)
+	{
+		return (uint32_t)(Next() % count);
+	}
+
+private:
+	uint64_t m_State;
+};
+
+StressScene::StressScene(const StressSceneCreateInfo& createInfo)
+{
+	PROFILE_FUNCTION();
+
+	if (createInfo.ObjectCount == 0 || createInfo.MeshCount == 0 || createInfo.MaterialCount == 0)
+		throw std::runtime_error("A stress scene needs at least one object, mesh and material!");
+
+	if (createInfo.VerticesPerMesh < 3)
+		throw std::runtime_error("Stress scene meshes need at least 3 vertices!");
+
+	SceneRandom random(createInfo.Seed);
+
+	// Counter clockwise polygons of radius 1, which is clockwise once y points down and so front facing
+	const uint32_t vertexCount = createInfo.VerticesPerMesh;
+	const float angleStep = 2.0f * 3.14159265f / (float)vertexCount;
+
+	std::vector<uint32_t> indices;
+	indices.reserve((vertexCount - 2) * 3);
+	for (uint32_t i = 1; i + 1 < vertexCount; i++)
+		indices.insert(indices.end(), { 0, i, i + 1 });
+
+	// Created together so their optimization and simplification run in parallel
+	std::vector<Utils::VertexData> sceneVertices((size_t)vertexCount * createInfo.MeshCount);
+	std::vector<MeshDescription> meshes(createInfo.MeshCount);
+
+	for (uint32_t mesh = 0; mesh < createInfo.MeshCount; mesh++)
+	{
+		Utils::VertexData* vertices = &sceneVertices[(size_t)vertexCount * mesh];
+		const glm::vec4 color(random.Range(0.2f, 1.0f), random.Range(0.2f, 1.0f), random.Range(0.2f, 1.0f), 1.0f);
+		const float rotation = random.Range(0.0f, angleStep);
+
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const float angle = rotation + angleStep * (float)i;
+			// Darker towards one side so overlapping objects can be told apart
+			const float shade = 0.6f + 0.4f * (0.5f + 0.5f * std::cos(angle));
+			vertices[i] = { { std::cos(angle), std::sin(angle), 0.0f }, { color.x * shade, color.y * shade, color.z * shade, 1.0f } };
+		}
+
+		meshes[mesh] = { vertices, vertexCount, indices.data(), (uint32_t)indices.size() };
+	}
+
+	m_Meshes = VulkanRenderer::CreateMeshes(meshes);
+
+	// GPU driven rendering draws everything with the default material anyway
+	const uint32_t materialCount = VulkanRenderer::IsGpuDriven() ? 1 : createInfo.MaterialCount;
+	m_Materials.push_back(VulkanRenderer::DEFAULT_MATERIAL);
+
+	for (uint32_t i = 1; i < materialCount; i++)
+	{
+		MaterialDescription material;
+		material.DoubleSided = (i & 1) != 0;
+		material.Blend = (i & 2) == 0;
+		m_Materials.push_back(VulkanRenderer::CreateMaterial(material));
+	}
+
+	struct SceneObject
+	{
+		uint32_t Mesh;
+		uint32_t Material;
+		Utils::InstanceData Instance;
+	};
+
+	// Clip space is 2 by 2, objects of this size cover it Overdraw times. The scale jitter below adds about 2% on average
+	const float polygonArea = 0.5f * (float)vertexCount * std::sin(angleStep);
+	const float objectScale = std::sqrt(createInfo.Overdraw * 4.0f / ((float)createInfo.ObjectCount * polygonArea));
+
+	std::vector<SceneObject> objects(createInfo.ObjectCount);
+
+	for (uint32_t i = 0; i < createInfo.ObjectCount; i++)
+	{
+		SceneObject& object = objects[i];
+
+		if (createInfo.StateChanges == StateChangePattern::Interleaved)
+		{
+			object.Mesh = i % (uint32_t)m_Meshes.size();
+			object.Material = i % (uint32_t)m_Materials.size();
+		}
+		else
+		{
+			object.Mesh = random.Index((uint32_t)m_Meshes.size());
+			object.Material = random.Index((uint32_t)m_Materials.size());
+		}
+
+		const float scale = objectScale * random.Range(0.75f, 1.25f);
+
+		glm::mat4 transform(1.0f);
+		transform[0][0] = scale;
+		transform[1][1] = scale;
+		transform[3] = glm::vec4(random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f), 0.0f, 1.0f);
+
+		object.Instance.Transform = transform;
+		object.Instance.Color = glm::vec4(random.Range(0.5f, 1.0f), random.Range(0.5f, 1.0f), random.Range(0.5f, 1.0f), 1.0f);
+	}
+
+	if (createInfo.StateChanges == StateChangePattern::Sorted)
+	{
+		// Stable so the order within a group, and with it the blending, only depends on the seed
+		std::stable_sort(objects.begin(), objects.end(), [](const SceneObject& a, const SceneObject& b)
+		{
+			return a.Material != b.Material ? a.Material < b.Material : a.Mesh < b.Mesh;
+		});
+	}
+
+	m_Instances.reserve(objects.size());
+
+	for (const SceneObject& object : objects)
+	{
+		const VulkanRenderer::MeshHandle mesh = m_Meshes[object.Mesh];
+		const VulkanRenderer::MaterialHandle material = m_Materials[object.Material];
+
+		if (createInfo.BatchSubmits && !m_Submits.empty() && m_Submits.back().Mesh == mesh && m_Submits.back().Material == material)
+			m_Submits.back().InstanceCount++;
+		else
+			m_Submits.push_back({ mesh, material, (uint32_t)m_Instances.size(), 1 });
+
+		m_Instances.push_back(object.Instance);
+	}
+}
+
+StressScene::~StressScene()
+{
+	for (const auto mesh : m_Meshes)
+		VulkanRenderer::DestroyMesh(mesh);
+}
+
+bool StressScene::ParseArgument(int argc, char** argv, int& i, StressSceneCreateInfo& outCreateInfo)
+{
+	const char* option = argv[i];
+
+	if (strcmp(option, "--scene-batch") == 0)
+	{
+		outCreateInfo.BatchSubmits = true;
+		return true;
+	}
+
+	if (i + 1 >= argc)
+		return false;
+
+	const char* value = argv[i + 1];
+
+	if (strcmp(option, "--scene-seed") == 0)
+		outCreateInfo.Seed = std::stoull(value);
+	else if (strcmp(option, "--scene-objects") == 0)
+		outCreateInfo.ObjectCount = (uint32_t)std::stoul(value);
+	else if (strcmp(option, "--scene-meshes") == 0)
+		outCreateInfo.MeshCount = (uint32_t)std::stoul(value);
+	else if (strcmp(option, "--scene-vertices") == 0)
+		outCreateInfo.VerticesPerMesh = (uint32_t)std::stoul(value);
+	else if (strcmp(option, "--scene-materials") == 0)
+		outCreateInfo.MaterialCount = (uint32_t)std::stoul(value);
+	else if (strcmp(option, "--scene-overdraw") == 0)
+		outCreateInfo.Overdraw = std::stof(value);
+	else if (strcmp(option, "--scene-pattern") == 0)
+	{
+		if (strcmp(value, "interleaved") == 0)
+			outCreateInfo.StateChanges = StateChangePattern::Interleaved;
+		else if (strcmp(value, "random") == 0)
+			outCreateInfo.StateChanges = StateChangePattern::Random;
+		else
+		{
+			if (strcmp(value, "sorted") != 0)
+				std::cerr << "Unknown state change pattern '" << value << "', using sorted\n";
+
+			outCreateInfo.StateChanges = StateChangePattern::Sorted;
+		}
+	}
+	else
+		return false;
+
+	i++;
+	return true;
+}
+
+void StressScene::Submit() const
+{
+	PROFILE_FUNCTION();
+
+	for (const SceneSubmit& submit : m_Submits)
+		VulkanRenderer::SubmitInstanced(submit.Mesh, &m_Instances[submit.FirstInstance], submit.InstanceCount, submit.Material);
+}
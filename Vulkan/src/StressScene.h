@@ -0,0 +1,73 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+#include <string>
+#include <vector>
+
+// Order the objects are submitted in, which decides how many of them end up merged into the same draw
+enum class StateChangePattern
+{
+	// Grouped by material and mesh, the fewest draws and binds
+	Sorted,
+	// Cycles through the meshes and materials so every object changes both
+	Interleaved,
+	Random
+};
+
+struct StressSceneCreateInfo
+{
+	// The same seed always generates the same scene
+	uint64_t Seed = 1;
+	uint32_t ObjectCount = 1000;
+	// Distinct meshes the objects are spread over
+	uint32_t MeshCount = 16;
+	// Every mesh is a convex polygon, at least 3
+	uint32_t VerticesPerMesh = 16;
+	// Materials cycle through the DoubleSided and Blend combinations, so there are never more than 4 distinct pipelines however many
+	// materials there are. Ignored by GPU driven rendering
+	uint32_t MaterialCount = 1;
+	// Times the objects cover the screen on average
+	float Overdraw = 1.0f;
+	StateChangePattern StateChanges = StateChangePattern::Sorted;
+	// Consecutive objects with the same mesh and material are submitted with a single SubmitInstanced call instead of one call each
+	bool BatchSubmits = false;
+};
+
+// Deterministic scene of many small objects for scaling tests. It has to be created after the renderer is initialized and
+// destroyed before it shuts down, its materials stay until then since the renderer can't release them
+class StressScene
+{
+public:
+	StressScene(const StressSceneCreateInfo& createInfo);
+	StressScene(const StressScene&) = delete;
+	~StressScene();
+
+	// Applies the --scene-* option at argv[i] and moves i past its value, false if it isn't one
+	static bool ParseArgument(int argc, char** argv, int& i, StressSceneCreateInfo& outCreateInfo);
+
+	// Adds every object to the next Draw's draw list
+	void Submit() const;
+
+	uint32_t GetObjectCount() const { return (uint32_t)m_Instances.size(); }
+	uint32_t GetSubmitCount() const { return (uint32_t)m_Submits.size(); }
+	uint32_t GetMeshCount() const { return (uint32_t)m_Meshes.size(); }
+	uint32_t GetMaterialCount() const { return (uint32_t)m_Materials.size(); }
+
+private:
+	struct SceneSubmit
+	{
+		VulkanRenderer::MeshHandle Mesh;
+		VulkanRenderer::MaterialHandle Material;
+		uint32_t FirstInstance;
+		uint32_t InstanceCount;
+	};
+
+private:
+	std::vector<VulkanRenderer::MeshHandle> m_Meshes;
+	std::vector<VulkanRenderer::MaterialHandle> m_Materials;
+
+	// In submission order
+	std::vector<Utils::InstanceData> m_Instances;
+	std::vector<SceneSubmit> m_Submits;
+};
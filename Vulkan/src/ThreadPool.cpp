@@ -0,0 +1,93 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	// The thread calling ParallelFor counts as one of the threads
+	for (uint32_t i = 1; i < threadCount; i++)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Stop = true;
+	}
+
+	m_WorkAvailable.notify_all();
+
+	for (auto& worker : m_Workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& job)
+{
+	if (taskCount == 0)
+		return;
+
+	std::unique_lock lock(m_Mutex);
+	m_Job = &job;
+	m_TaskCount = taskCount;
+	m_NextTask = 0;
+	m_CompletedTasks = 0;
+	m_Exception = nullptr;
+
+	m_WorkAvailable.notify_all();
+
+	RunTasks(lock);
+	m_WorkDone.wait(lock, [this] { return m_CompletedTasks == m_TaskCount; });
+
+	m_Job = nullptr;
+	m_TaskCount = 0;
+
+	if (m_Exception)
+		std::rethrow_exception(m_Exception);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	PROFILE_THREAD_NAME("Thread pool worker");
+
+	std::unique_lock lock(m_Mutex);
+
+	while (true)
+	{
+		m_WorkAvailable.wait(lock, [this] { return m_Stop || m_NextTask < m_TaskCount; });
+
+		if (m_Stop)
+			return;
+
+		RunTasks(lock);
+	}
+}
+
+void ThreadPool::RunTasks(std::unique_lock<std::mutex>& lock)
+{
+	while (m_NextTask < m_TaskCount)
+	{
+		const uint32_t taskIndex = m_NextTask++;
+		const auto* job = m_Job;
+
+		lock.unlock();
+
+		std::exception_ptr exception = nullptr;
+		try
+		{
+			(*job)(taskIndex);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		lock.lock();
+
+		if (exception && !m_Exception)
+			m_Exception = exception;
+
+		if (++m_CompletedTasks == m_TaskCount)
+			m_WorkDone.notify_all();
+	}
+}
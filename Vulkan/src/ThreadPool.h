@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	ThreadPool(uint32_t threadCount);
+	ThreadPool(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// Worker threads plus the calling thread, which also picks up tasks while it waits
+	uint32_t GetThreadCount() const { return (uint32_t)m_Workers.size() + 1; }
+
+	// Runs job(taskIndex) for every task in [0, taskCount) and blocks until all of them are done.
+	// A task index is only ever run by one thread so it can be used to pick per task resources.
+	void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& job);
+
+private:
+	void WorkerLoop();
+	void RunTasks(std::unique_lock<std::mutex>& lock);
+
+private:
+	std::vector<std::thread> m_Workers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_WorkDone;
+
+	const std::function<void(uint32_t)>* m_Job = nullptr;
+	uint32_t m_TaskCount = 0;
+	uint32_t m_NextTask = 0;
+	uint32_t m_CompletedTasks = 0;
+	std::exception_ptr m_Exception = nullptr;
+	bool m_Stop = false;
+};
@@ -0,0 +1,249 @@
+#include "TlsfAllocator.h"
+
+#include <bit>
+#include <stdexcept>
+
+TlsfAllocator::TlsfAllocator(uint64_t size)
+	: m_Size(size)
+{
+	for (auto& lists : m_FreeLists)
+		for (auto& list : lists)
+			list = INVALID_NODE;
+
+	if (size > 0)
+		InsertFreeNode(CreateNode(0, size));
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || alignment == 0 || !std::has_single_bit(alignment))
+		throw std::runtime_error("Invalid allocation size or alignment!");
+
+	// Searching for size + alignment - 1 guarantees any region found can fit the aligned allocation
+	const uint64_t searchSize = size + alignment - 1;
+	if (searchSize < size || searchSize > m_Size)
+		return {};
+
+	uint32_t node = INVALID_NODE;
+	uint32_t firstLevel, secondLevel;
+	if (FindFreeNode(searchSize, firstLevel, secondLevel))
+	{
+		node = m_FreeLists[firstLevel][secondLevel];
+	}
+	else
+	{
+		// Rounding up can skip the only region that fits, fall back to searching the exact size's list
+		MapSize(searchSize, firstLevel, secondLevel);
+		for (uint32_t candidate = m_FreeLists[firstLevel][secondLevel]; candidate != INVALID_NODE; candidate = m_Nodes[candidate].NextFree)
+		{
+			if (m_Nodes[candidate].Size >= searchSize)
+			{
+				node = candidate;
+				break;
+			}
+		}
+
+		if (node == INVALID_NODE)
+			return {};
+	}
+
+	RemoveFreeNode(node);
+
+	// The padding in front of the aligned offset goes back into the free lists
+	const uint64_t padding = ((m_Nodes[node].Offset + alignment - 1) & ~(alignment - 1)) - m_Nodes[node].Offset;
+	if (padding > 0)
+	{
+		const uint32_t alignedNode = SplitNode(node, padding);
+		InsertFreeNode(node);
+		node = alignedNode;
+	}
+
+	if (m_Nodes[node].Size - size >= MIN_SPLIT_SIZE)
+		InsertFreeNode(SplitNode(node, size));
+
+	m_Nodes[node].Used = true;
+	m_UsedSize += m_Nodes[node].Size;
+	m_AllocationCount++;
+
+	return { m_Nodes[node].Offset, node };
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	uint32_t node = allocation.Node;
+	if (!m_Nodes[node].Used)
+		throw std::runtime_error("Allocation was already freed!");
+
+	m_Nodes[node].Used = false;
+	m_UsedSize -= m_Nodes[node].Size;
+	m_AllocationCount--;
+
+	// Merge with the physical neighbours if they are free so regions don't fragment over time
+	const uint32_t prev = m_Nodes[node].PrevPhysical;
+	if (prev != INVALID_NODE && !m_Nodes[prev].Used)
+	{
+		RemoveFreeNode(prev);
+		m_Nodes[prev].Size += m_Nodes[node].Size;
+		m_Nodes[prev].NextPhysical = m_Nodes[node].NextPhysical;
+		if (m_Nodes[node].NextPhysical != INVALID_NODE)
+			m_Nodes[m_Nodes[node].NextPhysical].PrevPhysical = prev;
+
+		ReleaseNode(node);
+		node = prev;
+	}
+
+	const uint32_t next = m_Nodes[node].NextPhysical;
+	if (next != INVALID_NODE && !m_Nodes[next].Used)
+	{
+		RemoveFreeNode(next);
+		m_Nodes[node].Size += m_Nodes[next].Size;
+		m_Nodes[node].NextPhysical = m_Nodes[next].NextPhysical;
+		if (m_Nodes[next].NextPhysical != INVALID_NODE)
+			m_Nodes[m_Nodes[next].NextPhysical].PrevPhysical = node;
+
+		ReleaseNode(next);
+	}
+
+	InsertFreeNode(node);
+}
+
+void TlsfAllocator::MapSize(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+{
+	// Sizes below SECOND_LEVEL_COUNT map linearly into the first level, above that every power of two is split in SECOND_LEVEL_COUNT ranges
+	if (size < SECOND_LEVEL_COUNT)
+	{
+		outFirstLevel = 0;
+		outSecondLevel = (uint32_t)size;
+		return;
+	}
+
+	const uint32_t msb = 63 - (uint32_t)std::countl_zero(size);
+	outFirstLevel = msb - SECOND_LEVEL_BITS + 1;
+	outSecondLevel = (uint32_t)(size >> (msb - SECOND_LEVEL_BITS)) & (SECOND_LEVEL_COUNT - 1);
+}
+
+bool TlsfAllocator::FindFreeNode(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel) const
+{
+	// Round the size up to the next range so every region in the list found is big enough
+	if (size >= SECOND_LEVEL_COUNT)
+	{
+		const uint32_t msb = 63 - (uint32_t)std::countl_zero(size);
+		const uint64_t roundedSize = size + (1ull << (msb - SECOND_LEVEL_BITS)) - 1;
+		if (roundedSize < size)
+			return false;
+
+		size = roundedSize;
+	}
+
+	uint32_t firstLevel, secondLevel;
+	MapSize(size, firstLevel, secondLevel);
+
+	if (firstLevel >= FIRST_LEVEL_COUNT)
+		return false;
+
+	uint32_t secondLevelMap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0)
+	{
+		const uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_FirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0)
+			return false;
+
+		firstLevel = (uint32_t)std::countr_zero(firstLevelMap);
+		secondLevelMap = m_SecondLevelBitmaps[firstLevel];
+	}
+
+	outFirstLevel = firstLevel;
+	outSecondLevel = (uint32_t)std::countr_zero(secondLevelMap);
+	return true;
+}
+
+uint32_t TlsfAllocator::CreateNode(uint64_t offset, uint64_t size)
+{
+	uint32_t node;
+	if (!m_UnusedNodes.empty())
+	{
+		node = m_UnusedNodes.back();
+		m_UnusedNodes.pop_back();
+		m_Nodes[node] = Node();
+	}
+	else
+	{
+		node = (uint32_t)m_Nodes.size();
+		m_Nodes.emplace_back();
+	}
+
+	m_Nodes[node].Offset = offset;
+	m_Nodes[node].Size = size;
+	return node;
+}
+
+void TlsfAllocator::ReleaseNode(uint32_t node)
+{
+	m_UnusedNodes.push_back(node);
+}
+
+void TlsfAllocator::InsertFreeNode(uint32_t node)
+{
+	uint32_t firstLevel, secondLevel;
+	MapSize(m_Nodes[node].Size, firstLevel, secondLevel);
+
+	const uint32_t head = m_FreeLists[firstLevel][secondLevel];
+	m_Nodes[node].PrevFree = INVALID_NODE;
+	m_Nodes[node].NextFree = head;
+	if (head != INVALID_NODE)
+		m_Nodes[head].PrevFree = node;
+
+	m_FreeLists[firstLevel][secondLevel] = node;
+	m_FirstLevelBitmap |= 1ull << firstLevel;
+	m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::RemoveFreeNode(uint32_t node)
+{
+	const uint32_t prev = m_Nodes[node].PrevFree;
+	const uint32_t next = m_Nodes[node].NextFree;
+
+	if (prev != INVALID_NODE)
+		m_Nodes[prev].NextFree = next;
+	if (next != INVALID_NODE)
+		m_Nodes[next].PrevFree = prev;
+
+	uint32_t firstLevel, secondLevel;
+	MapSize(m_Nodes[node].Size, firstLevel, secondLevel);
+
+	if (m_FreeLists[firstLevel][secondLevel] == node)
+	{
+		m_FreeLists[firstLevel][secondLevel] = next;
+		if (next == INVALID_NODE)
+		{
+			m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (m_SecondLevelBitmaps[firstLevel] == 0)
+				m_FirstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+
+	m_Nodes[node].PrevFree = INVALID_NODE;
+	m_Nodes[node].NextFree = INVALID_NODE;
+}
+
+uint32_t TlsfAllocator::SplitNode(uint32_t node, uint64_t size)
+{
+	// Keeps the first `size` bytes in node and returns a new node with the remainder, neither is in a free list
+	const uint32_t remainder = CreateNode(m_Nodes[node].Offset + size, m_Nodes[node].Size - size);
+
+	// CreateNode can reallocate m_Nodes, so the references are taken after it
+	Node& first = m_Nodes[node];
+	Node& second = m_Nodes[remainder];
+
+	first.Size = size;
+	second.PrevPhysical = node;
+	second.NextPhysical = first.NextPhysical;
+	if (first.NextPhysical != INVALID_NODE)
+		m_Nodes[first.NextPhysical].PrevPhysical = remainder;
+
+	first.NextPhysical = remainder;
+	return remainder;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Two level segregated fit allocator over an abstract range of offsets.
+// It doesn't own any memory, it only hands out offsets inside [0, size), allocating and freeing are O(1).
+class TlsfAllocator
+{
+public:
+	static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+	struct Allocation
+	{
+		uint64_t Offset = UINT64_MAX;
+		uint32_t Node = INVALID_NODE;
+
+		bool IsValid() const { return Node != INVALID_NODE; }
+	};
+
+public:
+	TlsfAllocator() = default;
+	TlsfAllocator(uint64_t size);
+
+	// Alignment has to be a power of two, returns an invalid allocation if there is no region big enough
+	Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+	void Free(const Allocation& allocation);
+
+	// Size reserved for the allocation, it can be slightly bigger than what was requested
+	uint64_t GetAllocationSize(const Allocation& allocation) const { return m_Nodes[allocation.Node].Size; }
+
+	uint64_t GetSize() const { return m_Size; }
+	uint64_t GetUsedSize() const { return m_UsedSize; }
+	uint64_t GetFreeSize() const { return m_Size - m_UsedSize; }
+	uint32_t GetAllocationCount() const { return m_AllocationCount; }
+	bool IsEmpty() const { return m_AllocationCount == 0; }
+
+private:
+	static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+	static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+	static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+
+	// Remainders smaller than this aren't split off into their own free region
+	static constexpr uint64_t MIN_SPLIT_SIZE = 16;
+
+	struct Node
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint32_t PrevPhysical = INVALID_NODE;
+		uint32_t NextPhysical = INVALID_NODE;
+		uint32_t PrevFree = INVALID_NODE;
+		uint32_t NextFree = INVALID_NODE;
+		bool Used = false;
+	};
+
+	static void MapSize(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel);
+	bool FindFreeNode(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel) const;
+
+	uint32_t CreateNode(uint64_t offset, uint64_t size);
+	void ReleaseNode(uint32_t node);
+	void InsertFreeNode(uint32_t node);
+	void RemoveFreeNode(uint32_t node);
+	uint32_t SplitNode(uint32_t node, uint64_t size);
+
+private:
+	uint64_t m_Size = 0;
+	uint64_t m_UsedSize = 0;
+	uint32_t m_AllocationCount = 0;
+
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_UnusedNodes;
+
+	uint64_t m_FirstLevelBitmap = 0;
+	uint32_t m_SecondLevelBitmaps[FIRST_LEVEL_COUNT]{};
+	uint32_t m_FreeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT]{};
+};
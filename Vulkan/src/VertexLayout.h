@@ -0,0 +1,92 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <vulkan/vulkan.h>
+#pragma warning(pop)
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace Utils
+{
+	// Quantized attribute storage, the format tells the vertex fetch how to expand it back to floats
+	struct Half4 { uint16_t Value[4]; };
+	struct Unorm8x4 { uint8_t Value[4]; };
+	struct Snorm16x2 { int16_t Value[2]; };
+
+	// Maps the C++ type of an attribute to its format, matrices take one location per column
+	template<typename T>
+	struct VertexAttributeFormat;
+
+	template<> struct VertexAttributeFormat<float> { static constexpr VkFormat Format = VK_FORMAT_R32_SFLOAT; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<glm::vec2> { static constexpr VkFormat Format = VK_FORMAT_R32G32_SFLOAT; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<glm::vec3> { static constexpr VkFormat Format = VK_FORMAT_R32G32B32_SFLOAT; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<glm::vec4> { static constexpr VkFormat Format = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<glm::mat4> { static constexpr VkFormat Format = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t Locations = 4; };
+	template<> struct VertexAttributeFormat<Half4> { static constexpr VkFormat Format = VK_FORMAT_R16G16B16A16_SFLOAT; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<Unorm8x4> { static constexpr VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM; static constexpr uint32_t Locations = 1; };
+	template<> struct VertexAttributeFormat<Snorm16x2> { static constexpr VkFormat Format = VK_FORMAT_R16G16_SNORM; static constexpr uint32_t Locations = 1; };
+
+	struct VertexAttribute
+	{
+		VkFormat Format;
+		uint32_t Offset;
+		uint32_t Locations;
+		// Bytes between the locations of a matrix
+		uint32_t LocationStride;
+	};
+
+	// Attributes of a vertex type in shader location order
+	template<typename Vertex, size_t AttributeCount>
+	struct VertexLayout
+	{
+		std::array<VertexAttribute, AttributeCount> Attributes;
+
+		static constexpr uint32_t Stride = (uint32_t)sizeof(Vertex);
+
+		constexpr uint32_t GetLocationCount() const
+		{
+			uint32_t count = 0;
+			for (const VertexAttribute& attribute : Attributes)
+				count += attribute.Locations;
+			return count;
+		}
+	};
+
+	template<typename Vertex, typename... Attributes>
+	constexpr VertexLayout<Vertex, sizeof...(Attributes)> MakeVertexLayout(Attributes... attributes)
+	{
+		return { { attributes... } };
+	}
+
+	template<const auto& Layout>
+	constexpr VkVertexInputBindingDescription GetBindingDescription(uint32_t binding, VkVertexInputRate inputRate)
+	{
+		return { binding, Layout.Stride, inputRate };
+	}
+
+	// Locations are assigned in order starting at firstLocation, the shader has to declare them the same way
+	template<const auto& Layout>
+	constexpr auto GetAttributeDescriptions(uint32_t binding, uint32_t firstLocation)
+	{
+		std::array<VkVertexInputAttributeDescription, Layout.GetLocationCount()> descriptions{};
+
+		uint32_t location = 0;
+		for (const VertexAttribute& attribute : Layout.Attributes)
+		{
+			for (uint32_t i = 0; i < attribute.Locations; i++, location++)
+				descriptions[location] = { firstLocation + location, binding, attribute.Format, attribute.Offset + attribute.LocationStride * i };
+		}
+
+		return descriptions;
+	}
+}
+
+#define VERTEX_ATTRIBUTE(vertex, member) Utils::VertexAttribute{ \
+	Utils::VertexAttributeFormat<decltype(vertex::member)>::Format, \
+	(uint32_t)offsetof(vertex, member), \
+	Utils::VertexAttributeFormat<decltype(vertex::member)>::Locations, \
+	(uint32_t)sizeof(decltype(vertex::member)) / Utils::VertexAttributeFormat<decltype(vertex::member)>::Locations }
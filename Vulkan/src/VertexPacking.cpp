@@ -0,0 +1,237 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define VERTEX_PACKING_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace Utils
+{
+	// Bit patterns the half conversion works with, as floats they are infinity, 65536 and 0.5
+	static constexpr uint32_t FLOAT_INFINITY_BITS = 255u << 23;
+	static constexpr uint32_t HALF_OVERFLOW_BITS = (127u + 16u) << 23;
+	static constexpr uint32_t HALF_DENORMAL_MAGIC_BITS = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+	// Smallest float that is still a normal half
+	static constexpr uint32_t HALF_MIN_NORMAL_BITS = 113u << 23;
+
+	// Keeps a zero normal from dividing by zero, it's encoded as +z
+	static constexpr float OCT_MIN_LENGTH = 1e-20f;
+
+	uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		uint32_t half;
+		if (bits >= HALF_OVERFLOW_BITS)
+			half = bits > FLOAT_INFINITY_BITS ? 0x7E00 : 0x7C00;
+		else if (bits < HALF_MIN_NORMAL_BITS)
+		{
+			// Adding 0.5 lines the mantissa up with the denormal's so the FPU does the rounding
+			float magic;
+			memcpy(&magic, &HALF_DENORMAL_MAGIC_BITS, sizeof(magic));
+
+			float absolute;
+			memcpy(&absolute, &bits, sizeof(absolute));
+			absolute += magic;
+
+			memcpy(&half, &absolute, sizeof(half));
+			half -= HALF_DENORMAL_MAGIC_BITS;
+		}
+		else
+		{
+			const uint32_t mantissaOdd = (bits >> 13) & 1;
+			bits += ((uint32_t)(15 - 127) << 23) + 0xFFF + mantissaOdd;
+			half = bits >> 13;
+		}
+
+		return (uint16_t)(half | (sign >> 16));
+	}
+
+	float HalfToFloat(uint16_t value)
+	{
+		const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1F;
+		const uint32_t mantissa = value & 0x3FF;
+
+		if (exponent == 0)
+		{
+			const float denormal = std::ldexp((float)mantissa, -24);
+			return sign != 0 ? -denormal : denormal;
+		}
+
+		const uint32_t bits = exponent == 0x1F
+			? sign | FLOAT_INFINITY_BITS | (mantissa << 13)
+			: sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+		float result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	glm::vec2 OctEncode(const glm::vec3& normal)
+	{
+		const float length = std::max((std::abs(normal.x) + std::abs(normal.y)) + std::abs(normal.z), OCT_MIN_LENGTH);
+		const glm::vec2 p(normal.x / length, normal.y / length);
+
+		if (normal.z >= 0.0f)
+			return p;
+
+		// The lower half is folded over the diagonals
+		return glm::vec2(
+			(1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+	}
+
+	// Non finite normals would make the encodings diverge and their conversion to integers undefined, they are packed as +z
+	static glm::vec3 SanitizeNormal(const glm::vec3& normal)
+	{
+		if (std::isfinite(normal.x) && std::isfinite(normal.y) && std::isfinite(normal.z))
+			return normal;
+
+		return glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+
+#ifdef VERTEX_PACKING_SSE2
+	static __m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	static __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// FloatToHalf on four lanes, the halves end up in the low 16 bits of each lane
+	static __m128i FloatToHalf4(__m128 value)
+	{
+		const __m128i signMask = _mm_set1_epi32((int32_t)0x80000000u);
+
+		__m128i bits = _mm_castps_si128(value);
+		const __m128i sign = _mm_and_si128(bits, signMask);
+		bits = _mm_xor_si128(bits, sign);
+
+		// The sign is cleared so the signed compares work on the bit patterns
+		const __m128i overflow = _mm_cmpgt_epi32(bits, _mm_set1_epi32((int32_t)HALF_OVERFLOW_BITS - 1));
+		const __m128i isNaN = _mm_cmpgt_epi32(bits, _mm_set1_epi32((int32_t)FLOAT_INFINITY_BITS));
+		const __m128i infinityOrNaN = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(isNaN, _mm_set1_epi32(0x0200)));
+
+		const __m128i isDenormal = _mm_cmpgt_epi32(_mm_set1_epi32((int32_t)HALF_MIN_NORMAL_BITS), bits);
+		const __m128i magic = _mm_set1_epi32((int32_t)HALF_DENORMAL_MAGIC_BITS);
+		const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(magic))), magic);
+
+		const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(bits, _mm_set1_epi32((int32_t)(((uint32_t)(15 - 127) << 23) + 0xFFF)));
+		normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissaOdd), 13);
+
+		__m128i half = Select(isDenormal, denormal, normal);
+		half = Select(overflow, infinityOrNaN, half);
+		return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+	}
+
+	static void PackVertex(const VertexData& vertex, PackedVertex& outPacked)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		// Sign extending the halves keeps the saturating pack from clamping the negative ones
+		__m128i position = FloatToHalf4(_mm_setr_ps(vertex.Position.x, vertex.Position.y, vertex.Position.z, 1.0f));
+		position = _mm_srai_epi32(_mm_slli_epi32(position, 16), 16);
+		_mm_storel_epi64((__m128i*)&outPacked.Position, _mm_packs_epi32(position, position));
+
+		__m128 color = _mm_setr_ps(vertex.Color.x, vertex.Color.y, vertex.Color.z, vertex.Color.w);
+		color = _mm_mul_ps(_mm_min_ps(_mm_max_ps(color, zero), one), _mm_set1_ps(255.0f));
+		__m128i colorBytes = _mm_cvtps_epi32(color);
+		colorBytes = _mm_packs_epi32(colorBytes, colorBytes);
+		colorBytes = _mm_packus_epi16(colorBytes, colorBytes);
+		const int32_t packedColor = _mm_cvtsi128_si32(colorBytes);
+		memcpy(&outPacked.Color, &packedColor, sizeof(outPacked.Color));
+
+		// Same operations in the same order as OctEncode
+		const glm::vec3 sanitizedNormal = SanitizeNormal(vertex.Normal);
+		const __m128 normal = _mm_setr_ps(sanitizedNormal.x, sanitizedNormal.y, sanitizedNormal.z, 0.0f);
+		const __m128 absolute = _mm_andnot_ps(signMask, normal);
+		__m128 length = _mm_add_ps(absolute, _mm_shuffle_ps(absolute, absolute, _MM_SHUFFLE(2, 3, 0, 1)));
+		length = _mm_add_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2)));
+		length = _mm_max_ps(length, _mm_set1_ps(OCT_MIN_LENGTH));
+
+		const __m128 p = _mm_div_ps(normal, length);
+		const __m128 absoluteSwapped = _mm_shuffle_ps(_mm_andnot_ps(signMask, p), _mm_andnot_ps(signMask, p), _MM_SHUFFLE(3, 2, 0, 1));
+		const __m128 signNotZero = Select(_mm_cmpge_ps(p, zero), one, minusOne);
+		const __m128 folded = _mm_mul_ps(_mm_sub_ps(one, absoluteSwapped), signNotZero);
+
+		const __m128 lowerHalf = _mm_cmplt_ps(_mm_shuffle_ps(normal, normal, _MM_SHUFFLE(2, 2, 2, 2)), zero);
+		__m128 encoded = Select(lowerHalf, folded, p);
+		encoded = _mm_mul_ps(_mm_min_ps(_mm_max_ps(encoded, minusOne), one), _mm_set1_ps(32767.0f));
+
+		__m128i encodedShorts = _mm_cvtps_epi32(encoded);
+		encodedShorts = _mm_packs_epi32(encodedShorts, encodedShorts);
+		const int32_t packedNormal = _mm_cvtsi128_si32(encodedShorts);
+		memcpy(&outPacked.Normal, &packedNormal, sizeof(outPacked.Normal));
+	}
+#else
+	static void PackVertex(const VertexData& vertex, PackedVertex& outPacked)
+	{
+		outPacked.Position = { FloatToHalf(vertex.Position.x), FloatToHalf(vertex.Position.y), FloatToHalf(vertex.Position.z), FloatToHalf(1.0f) };
+
+		// Ordered like _mm_max_ps and _mm_min_ps so NaN becomes 0
+		for (int32_t i = 0; i < 4; i++)
+			outPacked.Color.Value[i] = (uint8_t)std::nearbyint(std::min(std::max(0.0f, vertex.Color[i]), 1.0f) * 255.0f);
+
+		const glm::vec2 encoded = OctEncode(SanitizeNormal(vertex.Normal));
+		for (int32_t i = 0; i < 2; i++)
+			outPacked.Normal.Value[i] = (int16_t)std::nearbyint(std::clamp(encoded[i], -1.0f, 1.0f) * 32767.0f);
+	}
+#endif
+
+	void PackVertices(const VertexData* vertices, uint32_t count, PackedVertex* outPacked)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			PackVertex(vertices[i], outPacked[i]);
+	}
+
+	bool NarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* outNarrowed)
+	{
+		uint32_t i = 0;
+		uint32_t highBits = 0;
+
+#ifdef VERTEX_PACKING_SSE2
+		// Every index is or'ed into the accumulator so the range is only checked once at the end.
+		// The pack saturates signed values, the indices are biased into its range and the result unbiased
+		const __m128i bias = _mm_set1_epi32(0x8000);
+		__m128i highBitsAccumulator = _mm_setzero_si128();
+
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i low = _mm_loadu_si128((const __m128i*)(indices + i));
+			const __m128i high = _mm_loadu_si128((const __m128i*)(indices + i + 4));
+			highBitsAccumulator = _mm_or_si128(highBitsAccumulator, _mm_or_si128(_mm_srli_epi32(low, 16), _mm_srli_epi32(high, 16)));
+
+			const __m128i narrowed = _mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias));
+			_mm_storeu_si128((__m128i*)(outNarrowed + i), _mm_xor_si128(narrowed, _mm_set1_epi16((int16_t)0x8000)));
+		}
+
+		highBitsAccumulator = _mm_or_si128(highBitsAccumulator, _mm_srli_si128(highBitsAccumulator, 8));
+		highBitsAccumulator = _mm_or_si128(highBitsAccumulator, _mm_srli_si128(highBitsAccumulator, 4));
+		highBits = (uint32_t)_mm_cvtsi128_si32(highBitsAccumulator);
+#endif
+
+		for (; i < count; i++)
+		{
+			highBits |= indices[i] >> 16;
+			outNarrowed[i] = (uint16_t)indices[i];
+		}
+
+		return highBits == 0;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "VulkanUtils.h"
+
+namespace Utils
+{
+	// Round to nearest even, out of range values become infinity
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+
+	// Maps a unit vector onto an octahedron unfolded into [-1, 1]^2
+	glm::vec2 OctEncode(const glm::vec3& normal);
+
+	// Uses SSE2 where it's available, the scalar fallback gives the same results. Non finite normals are packed as +z
+	void PackVertices(const VertexData* vertices, uint32_t count, PackedVertex* outPacked);
+
+	// Copies the indices into outNarrowed while checking they fit, false if any doesn't and outNarrowed is then garbage
+	bool NarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* outNarrowed);
+}
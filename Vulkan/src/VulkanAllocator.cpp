@@ -0,0 +1,300 @@
+#include "VulkanAllocator.h"
+
+#include <mutex>
+#include <stdexcept>
+
+// Blocks are this big unless the heap is small, then each one takes an eighth of it
+static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+static constexpr VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+struct MemoryBlock
+{
+	VkDeviceMemory Memory = nullptr;
+	void* MappedData = nullptr;
+	TlsfAllocator Allocator;
+	// Sum of the sizes requested by the resources living in the block, the rest of Allocator's used size is waste
+	VkDeviceSize RequestedBytes = 0;
+};
+
+// Every memory type has a pool for buffers and one for optimally tiled images
+struct MemoryPool
+{
+	uint32_t MemoryTypeIndex = 0;
+	VkDeviceSize BlockSize = 0;
+	std::vector<MemoryBlock> Blocks{};
+};
+
+struct AllocatorContext
+{
+	VkPhysicalDevice PhysicalDevice = nullptr;
+	VkDevice LogicalDevice = nullptr;
+	VkPhysicalDeviceMemoryProperties MemoryProperties{};
+	VkDeviceSize BufferImageGranularity = 1;
+
+	std::vector<MemoryPool> Pools{};
+	VkDeviceSize DedicatedBytes[VK_MAX_MEMORY_TYPES]{};
+	uint32_t DedicatedCounts[VK_MAX_MEMORY_TYPES]{};
+
+	std::mutex Mutex;
+};
+
+static AllocatorContext* s_Context = nullptr;
+
+static uint32_t GetPoolIndex(uint32_t memoryTypeIndex, bool optimalImage)
+{
+	return memoryTypeIndex * 2 + (optimalImage ? 1 : 0);
+}
+
+void VulkanAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+{
+	s_Context = new AllocatorContext();
+	s_Context->PhysicalDevice = physicalDevice;
+	s_Context->LogicalDevice = logicalDevice;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &s_Context->MemoryProperties);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	s_Context->BufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+
+	s_Context->Pools.resize(s_Context->MemoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < s_Context->MemoryProperties.memoryTypeCount; i++)
+	{
+		const VkMemoryType& memoryType = s_Context->MemoryProperties.memoryTypes[i];
+		const VkDeviceSize heapSize = s_Context->MemoryProperties.memoryHeaps[memoryType.heapIndex].size;
+		const VkDeviceSize blockSize = heapSize <= SMALL_HEAP_SIZE ? heapSize / 8 : DEFAULT_BLOCK_SIZE;
+
+		for (const bool optimalImage : { false, true })
+		{
+			MemoryPool& pool = s_Context->Pools[GetPoolIndex(i, optimalImage)];
+			pool.MemoryTypeIndex = i;
+			pool.BlockSize = blockSize;
+		}
+	}
+}
+
+void VulkanAllocator::Shutdown()
+{
+	// Init may not have been reached if the renderer failed early
+	if (s_Context == nullptr)
+		return;
+
+	for (auto& pool : s_Context->Pools)
+	{
+		for (auto& block : pool.Blocks)
+		{
+			if (block.Memory)
+				vkFreeMemory(s_Context->LogicalDevice, block.Memory, nullptr);
+		}
+	}
+
+	delete s_Context;
+	s_Context = nullptr;
+}
+
+VulkanAllocation VulkanAllocator::AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(s_Context->LogicalDevice, buffer, &memRequirements);
+
+	VulkanAllocation allocation = Allocate(memRequirements, properties, false);
+	vkBindBufferMemory(s_Context->LogicalDevice, buffer, allocation.Memory, allocation.Offset);
+	return allocation;
+}
+
+VulkanAllocation VulkanAllocator::AllocateImageMemory(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(s_Context->LogicalDevice, image, &memRequirements);
+
+	// Linear images follow the same granularity rules as buffers so they can share their blocks
+	VulkanAllocation allocation = Allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
+	vkBindImageMemory(s_Context->LogicalDevice, image, allocation.Memory, allocation.Offset);
+	return allocation;
+}
+
+VulkanAllocation VulkanAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage)
+{
+	const uint32_t memoryTypeIndex = FindMemoryTypeIndex(requirements.memoryTypeBits, properties);
+	if (memoryTypeIndex == UINT32_MAX)
+		throw std::runtime_error("Failed to find a suitable memory type!");
+
+	std::lock_guard lock(s_Context->Mutex);
+
+	// With no granularity restriction buffers and images can be packed next to each other
+	const bool separateImages = optimalImage && s_Context->BufferImageGranularity > 1;
+	const uint32_t poolIndex = GetPoolIndex(memoryTypeIndex, separateImages);
+	MemoryPool& pool = s_Context->Pools[poolIndex];
+
+	VulkanAllocation allocation;
+	allocation.Size = requirements.size;
+	allocation.Pool = poolIndex;
+
+	// Big resources would waste most of a block, they get their own memory
+	if (requirements.size > pool.BlockSize / 2)
+	{
+		allocation.Memory = AllocateDeviceMemory(memoryTypeIndex, requirements.size, &allocation.MappedData);
+		s_Context->DedicatedBytes[memoryTypeIndex] += requirements.size;
+		s_Context->DedicatedCounts[memoryTypeIndex]++;
+		return allocation;
+	}
+
+	uint32_t freeSlot = UINT32_MAX;
+	for (uint32_t i = 0; i < (uint32_t)pool.Blocks.size(); i++)
+	{
+		MemoryBlock& block = pool.Blocks[i];
+		if (!block.Memory)
+		{
+			freeSlot = i;
+			continue;
+		}
+
+		const TlsfAllocator::Allocation subAllocation = block.Allocator.Allocate(requirements.size, requirements.alignment);
+		if (subAllocation.IsValid())
+		{
+			allocation.Block = i;
+			allocation.SubAllocation = subAllocation;
+			break;
+		}
+	}
+
+	if (allocation.Block == UINT32_MAX)
+	{
+		if (freeSlot == UINT32_MAX)
+		{
+			freeSlot = (uint32_t)pool.Blocks.size();
+			pool.Blocks.emplace_back();
+		}
+
+		MemoryBlock& block = pool.Blocks[freeSlot];
+		block.Memory = AllocateDeviceMemory(memoryTypeIndex, pool.BlockSize, &block.MappedData);
+		block.Allocator = TlsfAllocator(pool.BlockSize);
+		block.RequestedBytes = 0;
+
+		allocation.Block = freeSlot;
+		allocation.SubAllocation = block.Allocator.Allocate(requirements.size, requirements.alignment);
+	}
+
+	MemoryBlock& block = pool.Blocks[allocation.Block];
+	block.RequestedBytes += requirements.size;
+
+	allocation.Memory = block.Memory;
+	allocation.Offset = allocation.SubAllocation.Offset;
+	if (block.MappedData)
+		allocation.MappedData = (uint8_t*)block.MappedData + allocation.Offset;
+
+	return allocation;
+}
+
+void VulkanAllocator::Free(VulkanAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::lock_guard lock(s_Context->Mutex);
+
+	MemoryPool& pool = s_Context->Pools[allocation.Pool];
+
+	if (allocation.Block == UINT32_MAX)
+	{
+		vkFreeMemory(s_Context->LogicalDevice, allocation.Memory, nullptr);
+		s_Context->DedicatedBytes[pool.MemoryTypeIndex] -= allocation.Size;
+		s_Context->DedicatedCounts[pool.MemoryTypeIndex]--;
+	}
+	else
+	{
+		MemoryBlock& block = pool.Blocks[allocation.Block];
+		block.Allocator.Free(allocation.SubAllocation);
+		block.RequestedBytes -= allocation.Size;
+
+		// Keep one empty block around so a resource that gets recreated every frame doesn't allocate every frame
+		if (block.Allocator.IsEmpty())
+		{
+			for (uint32_t i = 0; i < (uint32_t)pool.Blocks.size(); i++)
+			{
+				if (i != allocation.Block && pool.Blocks[i].Memory && pool.Blocks[i].Allocator.IsEmpty())
+				{
+					vkFreeMemory(s_Context->LogicalDevice, block.Memory, nullptr);
+					block = MemoryBlock();
+					break;
+				}
+			}
+		}
+	}
+
+	allocation = VulkanAllocation();
+}
+
+std::vector<VulkanHeapStats> VulkanAllocator::GetHeapStats()
+{
+	std::lock_guard lock(s_Context->Mutex);
+
+	const VkPhysicalDeviceMemoryProperties& memProperties = s_Context->MemoryProperties;
+
+	std::vector<VulkanHeapStats> stats(memProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+		stats[i].HeapSize = memProperties.memoryHeaps[i].size;
+
+	for (const auto& pool : s_Context->Pools)
+	{
+		VulkanHeapStats& heapStats = stats[memProperties.memoryTypes[pool.MemoryTypeIndex].heapIndex];
+
+		for (const auto& block : pool.Blocks)
+		{
+			if (!block.Memory)
+				continue;
+
+			heapStats.AllocatedBytes += block.Allocator.GetSize();
+			heapStats.UsedBytes += block.RequestedBytes;
+			heapStats.WastedBytes += block.Allocator.GetUsedSize() - block.RequestedBytes;
+			heapStats.BlockCount++;
+			heapStats.AllocationCount += block.Allocator.GetAllocationCount();
+		}
+	}
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		VulkanHeapStats& heapStats = stats[memProperties.memoryTypes[i].heapIndex];
+		heapStats.AllocatedBytes += s_Context->DedicatedBytes[i];
+		heapStats.UsedBytes += s_Context->DedicatedBytes[i];
+		heapStats.DedicatedAllocationCount += s_Context->DedicatedCounts[i];
+		heapStats.AllocationCount += s_Context->DedicatedCounts[i];
+	}
+
+	return stats;
+}
+
+uint32_t VulkanAllocator::FindMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties)
+{
+	const VkPhysicalDeviceMemoryProperties& memProperties = s_Context->MemoryProperties;
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if (allowedTypes & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+
+	return UINT32_MAX;
+}
+
+VkDeviceMemory VulkanAllocator::AllocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void** outMappedData)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(s_Context->LogicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate Device Memory!");
+
+	// Host visible memory stays mapped for its whole lifetime, mapping it again per resource isn't allowed once it's shared
+	*outMappedData = nullptr;
+	if (s_Context->MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(s_Context->LogicalDevice, memory, 0, VK_WHOLE_SIZE, 0, outMappedData) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map Device Memory!");
+	}
+
+	return memory;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "TlsfAllocator.h"
+
+#pragma warning(push, 0)
+#include <vulkan/vulkan.h>
+#pragma warning(pop)
+
+#include <vector>
+
+struct VulkanAllocation
+{
+	VkDeviceMemory Memory = nullptr;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+
+	// Persistently mapped pointer to the start of the allocation, null if the memory isn't host visible
+	void* MappedData = nullptr;
+
+	uint32_t Pool = UINT32_MAX;
+	// UINT32_MAX if the allocation owns its VkDeviceMemory
+	uint32_t Block = UINT32_MAX;
+	TlsfAllocator::Allocation SubAllocation{};
+
+	bool IsValid() const { return Memory != nullptr; }
+};
+
+struct VulkanHeapStats
+{
+	VkDeviceSize HeapSize = 0;
+	// Device memory allocated from the heap, blocks and dedicated allocations
+	VkDeviceSize AllocatedBytes = 0;
+	// Bytes requested by live resources
+	VkDeviceSize UsedBytes = 0;
+	// Bytes reserved for live resources that they don't use, size class rounding and unsplit remainders.
+	// Alignment padding goes back to the free list so it isn't counted
+	VkDeviceSize WastedBytes = 0;
+	uint32_t BlockCount = 0;
+	uint32_t DedicatedAllocationCount = 0;
+	uint32_t AllocationCount = 0;
+};
+
+// Places resources inside large VkDeviceMemory blocks, one list of blocks per memory type.
+// Buffers and optimally tiled images are kept in separate blocks so bufferImageGranularity never has to be padded for.
+class VulkanAllocator
+{
+public:
+	static void Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+	static void Shutdown();
+
+	// Allocates memory for the resource and binds it
+	static VulkanAllocation AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	static VulkanAllocation AllocateImageMemory(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+	static void Free(VulkanAllocation& allocation);
+
+	// One entry per memory heap of the physical device
+	static std::vector<VulkanHeapStats> GetHeapStats();
+
+private:
+	static VulkanAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage);
+	static uint32_t FindMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties);
+	static VkDeviceMemory AllocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void** outMappedData);
+};
@@ -0,0 +1,70 @@
+#include "VulkanGeometryPool.h"
+
+#include "VulkanUtils.h"
+
+VulkanGeometryPool::VulkanGeometryPool(const GeometryPoolCreateInfo& createInfo)
+	: m_VertexAllocator(createInfo.VertexCapacity), m_IndexAllocator(createInfo.IndexCapacity * 2ull), m_Device(createInfo.LogicalDevice)
+{
+	Utils::CreateBufferInfo vertexBufferInfo = {
+		vertexBufferInfo.LogicalDevice = m_Device,
+		vertexBufferInfo.BufferSize = sizeof(Utils::PackedVertex) * (VkDeviceSize)createInfo.VertexCapacity,
+		vertexBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		vertexBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		vertexBufferInfo.Buffer = &m_VertexBuffer,
+		vertexBufferInfo.BufferAllocation = &m_VertexBufferAllocation
+	};
+
+	Utils::CreateBuffer(vertexBufferInfo);
+
+	Utils::CreateBufferInfo indexBufferInfo = {
+		indexBufferInfo.LogicalDevice = m_Device,
+		indexBufferInfo.BufferSize = sizeof(uint32_t) * (VkDeviceSize)createInfo.IndexCapacity,
+		indexBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		indexBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		indexBufferInfo.Buffer = &m_IndexBuffer,
+		indexBufferInfo.BufferAllocation = &m_IndexBufferAllocation
+	};
+
+	Utils::CreateBuffer(indexBufferInfo);
+}
+
+void VulkanGeometryPool::Destroy()
+{
+	vkDestroyBuffer(m_Device, m_VertexBuffer, nullptr);
+	m_VertexBuffer = nullptr;
+	VulkanAllocator::Free(m_VertexBufferAllocation);
+
+	vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
+	m_IndexBuffer = nullptr;
+	VulkanAllocator::Free(m_IndexBufferAllocation);
+}
+
+GeometryRange VulkanGeometryPool::Allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType)
+{
+	GeometryRange range;
+	range.VertexAllocation = m_VertexAllocator.Allocate(vertexCount);
+	if (!range.VertexAllocation.IsValid())
+		throw std::runtime_error("Geometry pool is out of vertex space, increase RendererCreateInfo::GeometryVertexCapacity!");
+
+	const uint64_t slotsPerIndex = indexType == VK_INDEX_TYPE_UINT16 ? 1 : 2;
+	range.IndexAllocation = m_IndexAllocator.Allocate(indexCount * slotsPerIndex, slotsPerIndex);
+	if (!range.IndexAllocation.IsValid())
+	{
+		m_VertexAllocator.Free(range.VertexAllocation);
+		throw std::runtime_error("Geometry pool is out of index space, increase RendererCreateInfo::GeometryIndexCapacity!");
+	}
+
+	range.VertexOffset = (int32_t)range.VertexAllocation.Offset;
+	range.VertexCount = vertexCount;
+	range.FirstIndex = (uint32_t)(range.IndexAllocation.Offset / slotsPerIndex);
+	range.IndexCount = indexCount;
+	range.IndexType = indexType;
+	return range;
+}
+
+void VulkanGeometryPool::Free(GeometryRange& range)
+{
+	m_VertexAllocator.Free(range.VertexAllocation);
+	m_IndexAllocator.Free(range.IndexAllocation);
+	range = GeometryRange();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "VulkanAllocator.h"
+#include "TlsfAllocator.h"
+
+struct GeometryRange
+{
+	int32_t VertexOffset = 0;
+	uint32_t VertexCount = 0;
+	// In elements of IndexType, relative to the start of the index buffer
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+
+	TlsfAllocator::Allocation VertexAllocation{};
+	TlsfAllocator::Allocation IndexAllocation{};
+
+	bool IsValid() const { return VertexAllocation.IsValid(); }
+};
+
+// One vertex buffer and one index buffer shared by every mesh so a whole draw list binds them once.
+// Space is handed out in whole vertices and indices, meshes draw their range through the vkCmdDrawIndexed offsets.
+// 16 and 32 bit indices share the index buffer, binding it with the other type is all it takes to switch between them.
+class VulkanGeometryPool
+{
+public:
+	struct GeometryPoolCreateInfo
+	{
+		VkDevice LogicalDevice;
+		uint32_t VertexCapacity;
+		// In 32 bit indices, twice as many 16 bit ones fit
+		uint32_t IndexCapacity;
+	};
+
+public:
+	VulkanGeometryPool() = default;
+	VulkanGeometryPool(const GeometryPoolCreateInfo& createInfo);
+	void Destroy();
+
+	// Throws if the pool doesn't have enough contiguous space left
+	GeometryRange Allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType);
+	void Free(GeometryRange& range);
+
+	VkBuffer GetVertexBuffer() const { return m_VertexBuffer; }
+	VkBuffer GetIndexBuffer() const { return m_IndexBuffer; }
+
+	uint32_t GetUsedVertexCount() const { return (uint32_t)m_VertexAllocator.GetUsedSize(); }
+	VkDeviceSize GetUsedIndexBytes() const { return m_IndexAllocator.GetUsedSize() * sizeof(uint16_t); }
+
+private:
+	VkBuffer m_VertexBuffer = nullptr;
+	VulkanAllocation m_VertexBufferAllocation{};
+	TlsfAllocator m_VertexAllocator;
+
+	VkBuffer m_IndexBuffer = nullptr;
+	VulkanAllocation m_IndexBufferAllocation{};
+	// Hands out 16 bit slots, 32 bit indices take two aligned ones each
+	TlsfAllocator m_IndexAllocator;
+
+	VkDevice m_Device = nullptr;
+};
@@ -0,0 +1,314 @@
+#include "VulkanGpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+struct FrameQueries
+{
+	// Zone i owns queries 2i and 2i + 1
+	VkQueryPool QueryPool = nullptr;
+	std::vector<std::string> ZoneNames{};
+	bool Submitted = false;
+
+	VkQueryPool StatisticsQueryPool = nullptr;
+	bool StatisticsRecorded = false;
+};
+
+struct ZoneHistory
+{
+	std::string Name;
+	// Ring of the latest samples
+	std::vector<float> Samples{};
+	uint32_t NextSample = 0;
+	float LastMs = 0.0f;
+};
+
+// Results come back in bit order, which is the order of the PipelineStatistics members
+static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTIC_FLAGS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+static constexpr uint32_t PIPELINE_STATISTIC_COUNT = sizeof(PipelineStatistics) / sizeof(uint64_t);
+
+struct GpuProfilerContext
+{
+	VkDevice LogicalDevice = nullptr;
+	bool Enabled = false;
+	bool StatisticsEnabled = false;
+	// Nanoseconds per timestamp tick
+	float TimestampPeriod = 0.0f;
+	uint64_t TimestampMask = 0;
+	uint32_t MaxZonesPerFrame = 0;
+	uint32_t HistorySize = 0;
+
+	std::vector<FrameQueries> Frames{};
+	// Guards the zone names of every frame, secondary command buffers record zones in parallel
+	std::mutex ZoneMutex;
+
+	std::vector<ZoneHistory> Zones{};
+	std::unordered_map<std::string, size_t> ZoneIndices{};
+
+	PipelineStatistics LastStatistics{};
+	bool StatisticsCollected = false;
+};
+
+static GpuProfilerContext* s_Context = nullptr;
+
+static void AddSample(const std::string& name, float ms)
+{
+	auto [it, inserted] = s_Context->ZoneIndices.emplace(name, s_Context->Zones.size());
+	if (inserted)
+		s_Context->Zones.push_back({ name });
+
+	ZoneHistory& zone = s_Context->Zones[it->second];
+
+	if (zone.Samples.size() < s_Context->HistorySize)
+		zone.Samples.push_back(ms);
+	else
+		zone.Samples[zone.NextSample] = ms;
+
+	zone.NextSample = (zone.NextSample + 1) % s_Context->HistorySize;
+	zone.LastMs = ms;
+}
+
+void VulkanGpuProfiler::Init(const GpuProfilerCreateInfo& createInfo)
+{
+	s_Context = new GpuProfilerContext();
+	s_Context->LogicalDevice = createInfo.LogicalDevice;
+	s_Context->MaxZonesPerFrame = createInfo.MaxZonesPerFrame;
+	s_Context->HistorySize = std::max(createInfo.HistorySize, 1u);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(createInfo.PhysicalDevice, &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(createInfo.PhysicalDevice, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(createInfo.PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	const uint32_t validBits = queueFamilies[createInfo.QueueFamilyIndex].timestampValidBits;
+
+	s_Context->Enabled = validBits > 0;
+	s_Context->StatisticsEnabled = createInfo.PipelineStatistics;
+	s_Context->TimestampPeriod = deviceProperties.limits.timestampPeriod;
+	s_Context->TimestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+	s_Context->Frames.resize(createInfo.FramesInFlight);
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = 2 * createInfo.MaxZonesPerFrame;
+
+	VkQueryPoolCreateInfo statisticsPoolCreateInfo = {};
+	statisticsPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	statisticsPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	statisticsPoolCreateInfo.queryCount = 1;
+	statisticsPoolCreateInfo.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+
+	for (auto& frame : s_Context->Frames)
+	{
+		if (s_Context->Enabled && vkCreateQueryPool(s_Context->LogicalDevice, &queryPoolCreateInfo, nullptr, &frame.QueryPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Query Pool!");
+
+		if (s_Context->StatisticsEnabled && vkCreateQueryPool(s_Context->LogicalDevice, &statisticsPoolCreateInfo, nullptr, &frame.StatisticsQueryPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Query Pool!");
+	}
+}
+
+void VulkanGpuProfiler::Shutdown()
+{
+	if (s_Context == nullptr)
+		return;
+
+	for (auto& frame : s_Context->Frames)
+	{
+		vkDestroyQueryPool(s_Context->LogicalDevice, frame.QueryPool, nullptr);
+		vkDestroyQueryPool(s_Context->LogicalDevice, frame.StatisticsQueryPool, nullptr);
+	}
+
+	delete s_Context;
+	s_Context = nullptr;
+}
+
+bool VulkanGpuProfiler::IsEnabled()
+{
+	return s_Context != nullptr && s_Context->Enabled;
+}
+
+bool VulkanGpuProfiler::IsPipelineStatisticsEnabled()
+{
+	return s_Context != nullptr && s_Context->StatisticsEnabled;
+}
+
+void VulkanGpuProfiler::CollectResults(uint32_t frameIndex)
+{
+	if (s_Context == nullptr)
+		return;
+
+	FrameQueries& frame = s_Context->Frames[frameIndex];
+	if (!frame.Submitted)
+		return;
+
+	frame.Submitted = false;
+
+	if (frame.StatisticsRecorded)
+	{
+		uint64_t statistics[PIPELINE_STATISTIC_COUNT];
+		if (vkGetQueryPoolResults(s_Context->LogicalDevice, frame.StatisticsQueryPool, 0, 1, sizeof(statistics), statistics, sizeof(statistics),
+			VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			memcpy(&s_Context->LastStatistics, statistics, sizeof(PipelineStatistics));
+			s_Context->StatisticsCollected = true;
+		}
+	}
+
+	if (frame.ZoneNames.empty())
+		return;
+
+	const uint32_t queryCount = 2 * (uint32_t)frame.ZoneNames.size();
+	std::vector<uint64_t> timestamps(queryCount);
+
+	// Not ready only happens if the frame wasn't actually waited on, its samples are dropped instead of stalling
+	const VkResult result = vkGetQueryPoolResults(s_Context->LogicalDevice, frame.QueryPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	for (size_t i = 0; i < frame.ZoneNames.size(); i++)
+	{
+		const uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & s_Context->TimestampMask;
+		AddSample(frame.ZoneNames[i], (float)((double)ticks * s_Context->TimestampPeriod / 1000000.0));
+	}
+}
+
+void VulkanGpuProfiler::BeginRecording(uint32_t frameIndex, VkCommandBuffer commandBuffer, uint32_t keptZoneCount)
+{
+	if (s_Context == nullptr)
+		return;
+
+	FrameQueries& frame = s_Context->Frames[frameIndex];
+	frame.ZoneNames.resize(std::min((size_t)keptZoneCount, frame.ZoneNames.size()));
+	frame.Submitted = false;
+	frame.StatisticsRecorded = false;
+
+	// Part of the recording so every submission of the command buffer starts from reset queries
+	if (s_Context->Enabled)
+		vkCmdResetQueryPool(commandBuffer, frame.QueryPool, 0, 2 * s_Context->MaxZonesPerFrame);
+
+	if (s_Context->StatisticsEnabled)
+		vkCmdResetQueryPool(commandBuffer, frame.StatisticsQueryPool, 0, 1);
+}
+
+void VulkanGpuProfiler::MarkSubmitted(uint32_t frameIndex)
+{
+	if (s_Context != nullptr)
+		s_Context->Frames[frameIndex].Submitted = true;
+}
+
+uint32_t VulkanGpuProfiler::BeginZone(uint32_t frameIndex, VkCommandBuffer commandBuffer, const std::string& name)
+{
+	if (!IsEnabled())
+		return UINT32_MAX;
+
+	FrameQueries& frame = s_Context->Frames[frameIndex];
+	uint32_t zone;
+
+	{
+		std::lock_guard lock(s_Context->ZoneMutex);
+		if (frame.ZoneNames.size() >= s_Context->MaxZonesPerFrame)
+			return UINT32_MAX;
+
+		zone = (uint32_t)frame.ZoneNames.size();
+		frame.ZoneNames.push_back(name);
+	}
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.QueryPool, 2 * zone);
+	return zone;
+}
+
+void VulkanGpuProfiler::EndZone(uint32_t frameIndex, VkCommandBuffer commandBuffer, uint32_t zone)
+{
+	if (zone == UINT32_MAX)
+		return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s_Context->Frames[frameIndex].QueryPool, 2 * zone + 1);
+}
+
+uint32_t VulkanGpuProfiler::GetZoneCount(uint32_t frameIndex)
+{
+	if (s_Context == nullptr)
+		return 0;
+
+	std::lock_guard lock(s_Context->ZoneMutex);
+	return (uint32_t)s_Context->Frames[frameIndex].ZoneNames.size();
+}
+
+void VulkanGpuProfiler::BeginPipelineStatistics(uint32_t frameIndex, VkCommandBuffer commandBuffer)
+{
+	if (!IsPipelineStatisticsEnabled())
+		return;
+
+	FrameQueries& frame = s_Context->Frames[frameIndex];
+	vkCmdBeginQuery(commandBuffer, frame.StatisticsQueryPool, 0, 0);
+	frame.StatisticsRecorded = true;
+}
+
+void VulkanGpuProfiler::EndPipelineStatistics(uint32_t frameIndex, VkCommandBuffer commandBuffer)
+{
+	if (IsPipelineStatisticsEnabled())
+		vkCmdEndQuery(commandBuffer, s_Context->Frames[frameIndex].StatisticsQueryPool, 0);
+}
+
+VkQueryPipelineStatisticFlags VulkanGpuProfiler::GetPipelineStatisticFlags()
+{
+	return IsPipelineStatisticsEnabled() ? PIPELINE_STATISTIC_FLAGS : 0;
+}
+
+bool VulkanGpuProfiler::GetPipelineStatistics(PipelineStatistics& outStatistics)
+{
+	if (s_Context == nullptr || !s_Context->StatisticsCollected)
+		return false;
+
+	outStatistics = s_Context->LastStatistics;
+	return true;
+}
+
+std::vector<GpuZoneStats> VulkanGpuProfiler::GetZoneStats()
+{
+	std::vector<GpuZoneStats> stats;
+	if (!IsEnabled())
+		return stats;
+
+	std::vector<float> sorted;
+
+	for (const auto& zone : s_Context->Zones)
+	{
+		sorted = zone.Samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		float totalMs = 0.0f;
+		for (const float sample : sorted)
+			totalMs += sample;
+
+		const size_t p99Index = (size_t)std::ceil(0.99 * (double)sorted.size()) - 1;
+
+		GpuZoneStats& zoneStats = stats.emplace_back();
+		zoneStats.Name = zone.Name;
+		zoneStats.SampleCount = (uint32_t)sorted.size();
+		zoneStats.LastMs = zone.LastMs;
+		zoneStats.MinMs = sorted.front();
+		zoneStats.AverageMs = totalMs / (float)sorted.size();
+		zoneStats.P99Ms = sorted[p99Index];
+	}
+
+	return stats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <vulkan/vulkan.h>
+#pragma warning(pop)
+
+#include <string>
+#include <vector>
+
+struct GpuProfilerCreateInfo
+{
+	VkPhysicalDevice PhysicalDevice;
+	VkDevice LogicalDevice;
+	// Family of the queue the profiled command buffers are submitted to, it has to support timestamps
+	uint32_t QueueFamilyIndex;
+	// One query pool per frame in flight
+	uint32_t FramesInFlight;
+	uint32_t MaxZonesPerFrame;
+	// Samples per zone the rolling stats are computed from
+	uint32_t HistorySize;
+	// Requires the pipelineStatisticsQuery feature, and inheritedQueries when the query spans secondary command buffers
+	bool PipelineStatistics;
+};
+
+struct GpuZoneStats
+{
+	std::string Name;
+	uint32_t SampleCount = 0;
+	float LastMs = 0.0f;
+	float MinMs = 0.0f;
+	float AverageMs = 0.0f;
+	float P99Ms = 0.0f;
+};
+
+// Counted by the GPU over the span of a frame's statistics query
+struct PipelineStatistics
+{
+	uint64_t InputAssemblyVertices = 0;
+	uint64_t InputAssemblyPrimitives = 0;
+	uint64_t VertexShaderInvocations = 0;
+	// Primitives that reached clipping and the ones that came out of it, the difference was culled or clipped away
+	uint64_t ClippingInvocations = 0;
+	uint64_t ClippingPrimitives = 0;
+	// Compared to the covered pixels this is the overdraw
+	uint64_t FragmentShaderInvocations = 0;
+};
+
+// Measures the GPU time of named zones in recorded command buffers with timestamp queries.
+// Zones belong to the recording, a command buffer submitted again without being recorded produces new samples for all of them.
+// A frame's results are read when its slot comes around again FramesInFlight frames later, by then they are available and nothing waits.
+class VulkanGpuProfiler
+{
+public:
+	static void Init(const GpuProfilerCreateInfo& createInfo);
+	static void Shutdown();
+
+	// False when not initialized or when the queue can't write timestamps, zones are ignored then
+	static bool IsEnabled();
+	static bool IsPipelineStatisticsEnabled();
+
+	// Reads the results of the frame's last submission, the GPU has to be done with it and it can't be recording
+	static void CollectResults(uint32_t frameIndex);
+	// Forgets the frame's zones and records the reset of its queries, has to come before any zone and outside a render pass.
+	// The first keptZoneCount zones are kept, they were recorded into command buffers that are executed again without being recorded
+	static void BeginRecording(uint32_t frameIndex, VkCommandBuffer commandBuffer, uint32_t keptZoneCount = 0);
+	static void MarkSubmitted(uint32_t frameIndex);
+
+	// Zones can be recorded from several threads at once. Returns UINT32_MAX once the frame is out of queries, EndZone ignores it
+	static uint32_t BeginZone(uint32_t frameIndex, VkCommandBuffer commandBuffer, const std::string& name);
+	static void EndZone(uint32_t frameIndex, VkCommandBuffer commandBuffer, uint32_t zone);
+	// Zones begun since BeginRecording, including the kept ones
+	static uint32_t GetZoneCount(uint32_t frameIndex);
+
+	// In the order the zones were first seen
+	static std::vector<GpuZoneStats> GetZoneStats();
+
+	// One statistics query per frame, it can contain a render pass but not be begun inside one
+	static void BeginPipelineStatistics(uint32_t frameIndex, VkCommandBuffer commandBuffer);
+	static void EndPipelineStatistics(uint32_t frameIndex, VkCommandBuffer commandBuffer);
+	// Secondary command buffers executed while the query is active have to inherit these, 0 when disabled
+	static VkQueryPipelineStatisticFlags GetPipelineStatisticFlags();
+	// Of the last collected frame, false if none has been collected yet
+	static bool GetPipelineStatistics(PipelineStatistics& outStatistics);
+
+	class ScopedZone
+	{
+	public:
+		ScopedZone(uint32_t frameIndex, VkCommandBuffer commandBuffer, const std::string& name)
+			: m_FrameIndex(frameIndex), m_CommandBuffer(commandBuffer), m_Zone(BeginZone(frameIndex, commandBuffer, name)) {}
+		ScopedZone(const ScopedZone&) = delete;
+		~ScopedZone() { EndZone(m_FrameIndex, m_CommandBuffer, m_Zone); }
+
+	private:
+		uint32_t m_FrameIndex;
+		VkCommandBuffer m_CommandBuffer;
+		uint32_t m_Zone;
+	};
+};
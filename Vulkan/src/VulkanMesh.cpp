@@ -1,122 +1,84 @@
 #include "VulkanMesh.h"
 
+#include "VulkanUploader.h"
+#include "VertexPacking.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <vector>
+
 VulkanMesh::VulkanMesh(const MeshCreateInfo& meshCreateInfo)
-	: m_VertexCount(meshCreateInfo.VerticesCount), m_IndexCount(meshCreateInfo.IndicesCount),
-		m_PhysicalDevice(meshCreateInfo.PhysicalDevice), m_Device(meshCreateInfo.LogicalDevice)
+	: m_GeometryPool(meshCreateInfo.GeometryPool)
 {
-	CreateVertexBuffer(meshCreateInfo.TransferQueue, meshCreateInfo.TransferCommandPool, meshCreateInfo.Vertices, meshCreateInfo.VerticesCount);
-	CreateIndexBuffer(meshCreateInfo.TransferQueue, meshCreateInfo.TransferCommandPool, meshCreateInfo.Indices, meshCreateInfo.IndicesCount);
+	PROFILE_FUNCTION();
+
+	if (meshCreateInfo.LodCount > Utils::MAX_MESH_LODS)
+		throw std::runtime_error("Mesh has more levels of detail than Utils::MAX_MESH_LODS!");
+
+	// Most meshes have few enough vertices for 16 bit indices, which take half the memory and bandwidth
+	std::vector<uint16_t> narrowedIndices(meshCreateInfo.IndicesCount);
+	const bool narrowed = Utils::NarrowIndices(meshCreateInfo.Indices, meshCreateInfo.IndicesCount, narrowedIndices.data());
+
+	m_Range = m_GeometryPool->Allocate(meshCreateInfo.VerticesCount, meshCreateInfo.IndicesCount, narrowed ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+	m_LodCount = std::max(meshCreateInfo.LodCount, 1u);
+	m_Lods[0] = { 0, meshCreateInfo.IndicesCount, 0.0f };
+	for (uint32_t i = 0; i < meshCreateInfo.LodCount; i++)
+		m_Lods[i] = meshCreateInfo.Lods[i];
+
+	for (uint32_t i = 0; i < m_LodCount; i++)
+		m_Lods[i].FirstIndex += m_Range.FirstIndex;
+
+	for (uint32_t i = 0; i < meshCreateInfo.MeshletCount; i++)
+		m_Clusters.Add(meshCreateInfo.Meshlets[i], m_Range.FirstIndex);
+
+	std::vector<Utils::PackedVertex> packedVertices(meshCreateInfo.VerticesCount);
+	Utils::PackVertices(meshCreateInfo.Vertices, meshCreateInfo.VerticesCount, packedVertices.data());
+
+	VulkanUploader::UploadBuffer(m_GeometryPool->GetVertexBuffer(), sizeof(Utils::PackedVertex) * (VkDeviceSize)m_Range.VertexOffset,
+		packedVertices.data(), sizeof(Utils::PackedVertex) * (VkDeviceSize)meshCreateInfo.VerticesCount);
+
+	if (narrowed)
+	{
+		m_UploadTicket = VulkanUploader::UploadBuffer(m_GeometryPool->GetIndexBuffer(), sizeof(uint16_t) * (VkDeviceSize)m_Range.FirstIndex,
+			narrowedIndices.data(), sizeof(uint16_t) * (VkDeviceSize)meshCreateInfo.IndicesCount);
+	}
+	else
+	{
+		m_UploadTicket = VulkanUploader::UploadBuffer(m_GeometryPool->GetIndexBuffer(), sizeof(uint32_t) * (VkDeviceSize)m_Range.FirstIndex,
+			meshCreateInfo.Indices, sizeof(uint32_t) * (VkDeviceSize)meshCreateInfo.IndicesCount);
+	}
+
+	// Built from the rounded positions the GPU sees, centered on the bounding box. Not the tightest sphere but good enough for culling
+	std::vector<glm::vec3> positions(meshCreateInfo.VerticesCount);
+	for (uint32_t i = 0; i < meshCreateInfo.VerticesCount; i++)
+	{
+		const uint16_t* position = packedVertices[i].Position.Value;
+		positions[i] = glm::vec3(Utils::HalfToFloat(position[0]), Utils::HalfToFloat(position[1]), Utils::HalfToFloat(position[2]));
+	}
+
+	glm::vec3 min = positions[0];
+	glm::vec3 max = positions[0];
+	for (uint32_t i = 1; i < meshCreateInfo.VerticesCount; i++)
+	{
+		min = glm::min(min, positions[i]);
+		max = glm::max(max, positions[i]);
+	}
+
+	const glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t i = 0; i < meshCreateInfo.VerticesCount; i++)
+		radius = std::max(radius, glm::length(positions[i] - center));
+
+	m_BoundingSphere = glm::vec4(center, radius);
 }
 
 void VulkanMesh::Destroy()
 {
-	vkDestroyBuffer(m_Device, m_VertexBuffer, nullptr);
-	m_VertexBuffer = nullptr;
-	vkFreeMemory(m_Device, m_VertexBufferMemory, nullptr);
-
-	vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
-	m_IndexBuffer = nullptr;
-	vkFreeMemory(m_Device, m_IndexBufferMemory, nullptr);
-}
-
-void VulkanMesh::CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, Utils::VertexData const* vertices, uint32_t verticesCount)
-{
-	const VkDeviceSize bufferSize = sizeof(Utils::VertexData) * verticesCount;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	Utils::CreateBufferInfo stagingBufferInfo = {
-		stagingBufferInfo.PhysicalDevice = m_PhysicalDevice,
-		stagingBufferInfo.LogicalDevice = m_Device,
-		stagingBufferInfo.BufferSize = bufferSize,
-		stagingBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		stagingBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBufferInfo.Buffer = &stagingBuffer,
-		stagingBufferInfo.BufferMemory = &stagingBufferMemory
-	};
-
-	Utils::CreateBuffer(stagingBufferInfo);
-
-	void* data;
-	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices, bufferSize);
-	vkUnmapMemory(m_Device, stagingBufferMemory);
-
-	Utils::CreateBufferInfo vertexBufferInfo = {
-		vertexBufferInfo.PhysicalDevice = m_PhysicalDevice,
-		vertexBufferInfo.LogicalDevice = m_Device,
-		vertexBufferInfo.BufferSize = bufferSize,
-		vertexBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		vertexBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferInfo.Buffer = &m_VertexBuffer,
-		vertexBufferInfo.BufferMemory = &m_VertexBufferMemory
-	};
-
-	Utils::CreateBuffer(vertexBufferInfo);
-
-	Utils::CopyBufferInfo copyBufferInfo = {
-		copyBufferInfo.Device = m_Device,
-		copyBufferInfo.TransferQueue = transferQueue,
-		copyBufferInfo.TransferCommandPool = transferCommandPool,
-		copyBufferInfo.SrcBuffer = stagingBuffer,
-		copyBufferInfo.DstBuffer = m_VertexBuffer,
-		copyBufferInfo.BufferSize = bufferSize
-	};
-
-	Utils::CopyBuffer(copyBufferInfo);
-
-	vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+	m_GeometryPool->Free(m_Range);
 }
 
-void VulkanMesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, uint32_t const* indices, uint32_t indexCount)
+bool VulkanMesh::IsUploaded() const
 {
-	const VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	Utils::CreateBufferInfo stagingBufferInfo = {
-		stagingBufferInfo.PhysicalDevice = m_PhysicalDevice,
-		stagingBufferInfo.LogicalDevice = m_Device,
-		stagingBufferInfo.BufferSize = bufferSize,
-		stagingBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		stagingBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBufferInfo.Buffer = &stagingBuffer,
-		stagingBufferInfo.BufferMemory = &stagingBufferMemory
-	};
-
-	Utils::CreateBuffer(stagingBufferInfo);
-
-	void* data;
-	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices, bufferSize);
-	vkUnmapMemory(m_Device, stagingBufferMemory);
-
-	Utils::CreateBufferInfo indexBufferInfo = {
-		indexBufferInfo.PhysicalDevice = m_PhysicalDevice,
-		indexBufferInfo.LogicalDevice = m_Device,
-		indexBufferInfo.BufferSize = bufferSize,
-		indexBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		indexBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferInfo.Buffer = &m_IndexBuffer,
-		indexBufferInfo.BufferMemory = &m_IndexBufferMemory
-	};
-
-	Utils::CreateBuffer(indexBufferInfo);
-
-	Utils::CopyBufferInfo copyBufferInfo = {
-		copyBufferInfo.Device = m_Device,
-		copyBufferInfo.TransferQueue = transferQueue,
-		copyBufferInfo.TransferCommandPool = transferCommandPool,
-		copyBufferInfo.SrcBuffer = stagingBuffer,
-		copyBufferInfo.DstBuffer = m_IndexBuffer,
-		copyBufferInfo.BufferSize = bufferSize
-	};
-
-	Utils::CopyBuffer(copyBufferInfo);
-
-	vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+	return VulkanUploader::IsComplete(m_UploadTicket);
 }
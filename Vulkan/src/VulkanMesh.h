@@ -1,20 +1,28 @@
 #pragma once
 
 #include "VulkanUtils.h"
+#include "VulkanGeometryPool.h"
+#include "MeshSimplifier.h"
+#include "ClusterCulling.h"
+
+#include <array>
 
 class VulkanMesh
 {
 public:
 	struct MeshCreateInfo
 	{
-		VkPhysicalDevice PhysicalDevice;
-		VkDevice LogicalDevice;
-		VkQueue TransferQueue;
-		VkCommandPool TransferCommandPool;
+		VulkanGeometryPool* GeometryPool;
 		Utils::VertexData const* Vertices;
 		uint32_t VerticesCount;
 		uint32_t const* Indices;
 		uint32_t IndicesCount;
+		// Ranges of Indices, the first one is drawn at full detail. Without any the whole of Indices is the only level
+		MeshLod const* Lods;
+		uint32_t LodCount;
+		// Clusters of the full detail level, drawn separately when culled. Without any the level is only drawn whole
+		Meshlet const* Meshlets;
+		uint32_t MeshletCount;
 	};
 
 public:
@@ -22,25 +30,36 @@ public:
 	VulkanMesh(const MeshCreateInfo& meshCreateInfo);
 	void Destroy();
 
-	uint32_t GetVertexCount() const { return m_VertexCount; }
-	VkBuffer GetVertexBuffer() const { return m_VertexBuffer; }
+	bool IsValid() const { return m_Range.IsValid(); }
 
-	uint32_t GetIndicesCount() const { return m_IndexCount; }
-	VkBuffer GetIndexBuffer() const { return m_IndexBuffer; }
+	uint32_t GetVertexCount() const { return m_Range.VertexCount; }
+	int32_t GetVertexOffset() const { return m_Range.VertexOffset; }
 
-private:
-	void CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, Utils::VertexData const* vertices, uint32_t verticesCount);
-	void CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, uint32_t const* indices, uint32_t indexCount);
+	// Every level of detail is drawn with the same vertex offset, only the index range changes
+	uint32_t GetLodCount() const { return m_LodCount; }
+	uint32_t GetIndicesCount(uint32_t lod = 0) const { return m_Lods[lod].IndexCount; }
+	uint32_t GetFirstIndex(uint32_t lod = 0) const { return m_Lods[lod].FirstIndex; }
+	// Relative to the bounding sphere's radius
+	float GetLodError(uint32_t lod) const { return m_Lods[lod].Error; }
+	// 16 bit when every index fits, the index buffer has to be bound with it
+	VkIndexType GetIndexType() const { return m_Range.IndexType; }
 
-private:
-	uint32_t m_VertexCount = 0;
-	VkBuffer m_VertexBuffer =  nullptr;
-	VkDeviceMemory m_VertexBufferMemory = nullptr;
+	// xyz is the center and w the radius, encloses every vertex
+	const glm::vec4& GetBoundingSphere() const { return m_BoundingSphere; }
+	// Empty unless the mesh was split into meshlets
+	const ClusterBounds& GetClusters() const { return m_Clusters; }
 
-	uint32_t m_IndexCount = 0;
-	VkBuffer m_IndexBuffer = nullptr;
-	VkDeviceMemory m_IndexBufferMemory = nullptr;
+	// The range can be drawn straight away, this only tells whether the copies into it have finished
+	bool IsUploaded() const;
+
+private:
+	GeometryRange m_Range{};
+	glm::vec4 m_BoundingSphere{};
+	// First indices are relative to the start of the index buffer
+	std::array<MeshLod, Utils::MAX_MESH_LODS> m_Lods{};
+	uint32_t m_LodCount = 0;
+	ClusterBounds m_Clusters{};
+	uint64_t m_UploadTicket = 0;
 
-	VkPhysicalDevice m_PhysicalDevice = nullptr;
-	VkDevice m_Device = nullptr;
+	VulkanGeometryPool* m_GeometryPool = nullptr;
 };
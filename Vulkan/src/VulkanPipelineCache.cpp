@@ -0,0 +1,570 @@
+#include "VulkanPipelineCache.h"
+
+#include "VulkanShader.h"
+#include "VulkanUtils.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// Layout of VkPipelineCacheHeaderVersionOne, every driver writes it at the start of the cache data
+static constexpr size_t CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+struct PipelineCacheContext
+{
+	VkDevice LogicalDevice = nullptr;
+	VkPhysicalDeviceProperties DeviceProperties{};
+	std::string Filepath;
+	bool CreationFeedback = false;
+
+	VkPipelineCache Cache = nullptr;
+	uint32_t HitCount = 0;
+	uint32_t MissCount = 0;
+
+	// Only touched by the thread rendering, background builds reach it through CommitCompiledPipelines
+	std::unordered_map<GraphicsPipelineDescription, VkPipeline, GraphicsPipelineDescription::Hasher> GraphicsPipelines{};
+
+	struct CompileRequest
+	{
+		GraphicsPipelineDescription Description;
+		std::chrono::steady_clock::time_point RequestTime;
+	};
+
+	std::vector<std::thread> CompileThreads{};
+	// Guards everything below plus the counters above, which background builds update too
+	std::mutex CompileMutex;
+	std::condition_variable CompileRequested;
+	std::deque<CompileRequest> CompileQueue{};
+	// Queued, being built or built and not committed yet
+	std::unordered_set<GraphicsPipelineDescription, GraphicsPipelineDescription::Hasher> PendingPipelines{};
+	std::vector<std::pair<GraphicsPipelineDescription, VkPipeline>> CompiledPipelines{};
+	bool StopCompiling = false;
+
+	PipelineCompileStats CompileStats{};
+	float TotalCompileMs = 0.0f;
+	float TotalLatencyMs = 0.0f;
+};
+
+static PipelineCacheContext* s_Context = nullptr;
+
+// boost::hash_combine widened to 64 bits
+template<typename T>
+static uint64_t HashCombine(uint64_t hash, const T& value)
+{
+	return hash ^ ((uint64_t)std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+uint64_t GraphicsPipelineDescription::Hash() const
+{
+	uint64_t hash = 0;
+	hash = HashCombine(hash, Shader);
+	hash = HashCombine(hash, Layout);
+	hash = HashCombine(hash, RenderPass);
+	hash = HashCombine(hash, Subpass);
+	hash = HashCombine(hash, Topology);
+	hash = HashCombine(hash, PolygonMode);
+	hash = HashCombine(hash, CullMode);
+	hash = HashCombine(hash, FrontFace);
+	hash = HashCombine(hash, BlendEnable);
+	return hash;
+}
+
+void VulkanPipelineCache::Init(const PipelineCacheCreateInfo& createInfo)
+{
+	s_Context = new PipelineCacheContext();
+	s_Context->LogicalDevice = createInfo.LogicalDevice;
+	s_Context->Filepath = createInfo.Filepath;
+	s_Context->CreationFeedback = createInfo.CreationFeedback;
+
+	vkGetPhysicalDeviceProperties(createInfo.PhysicalDevice, &s_Context->DeviceProperties);
+
+	std::string data;
+	if (!s_Context->Filepath.empty())
+	{
+		std::ifstream in(s_Context->Filepath, std::ios::in | std::ios::binary);
+		if (in.is_open())
+			data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	if (!data.empty() && !IsCompatible(data))
+	{
+		std::cout << "Pipeline cache '" << s_Context->Filepath << "' was saved by a different device or driver, discarding it\n";
+		data.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = data.size();
+	cacheCreateInfo.pInitialData = data.data();
+
+	// The header matching doesn't guarantee the driver accepts the rest, start over empty if it doesn't
+	if (vkCreatePipelineCache(s_Context->LogicalDevice, &cacheCreateInfo, nullptr, &s_Context->Cache) != VK_SUCCESS)
+	{
+		cacheCreateInfo.initialDataSize = 0;
+		cacheCreateInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(s_Context->LogicalDevice, &cacheCreateInfo, nullptr, &s_Context->Cache) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Pipeline Cache!");
+
+		data.clear();
+	}
+
+	if (!data.empty())
+		std::cout << "Loaded " << data.size() << " bytes of pipeline cache from '" << s_Context->Filepath << "'\n";
+
+	for (uint32_t i = 0; i < createInfo.CompileThreadCount; i++)
+		s_Context->CompileThreads.emplace_back(&VulkanPipelineCache::CompileLoop);
+}
+
+void VulkanPipelineCache::Shutdown()
+{
+	if (s_Context == nullptr)
+		return;
+
+	{
+		std::lock_guard lock(s_Context->CompileMutex);
+		s_Context->StopCompiling = true;
+	}
+
+	// Builds already running are finished, anything still queued is dropped
+	s_Context->CompileRequested.notify_all();
+	for (auto& thread : s_Context->CompileThreads)
+		thread.join();
+
+	for (auto& [description, pipeline] : s_Context->CompiledPipelines)
+		vkDestroyPipeline(s_Context->LogicalDevice, pipeline, nullptr);
+
+	for (auto& [description, pipeline] : s_Context->GraphicsPipelines)
+		vkDestroyPipeline(s_Context->LogicalDevice, pipeline, nullptr);
+
+	if (s_Context->Cache != nullptr)
+	{
+		Save();
+		vkDestroyPipelineCache(s_Context->LogicalDevice, s_Context->Cache, nullptr);
+	}
+
+	delete s_Context;
+	s_Context = nullptr;
+}
+
+VkPipeline VulkanPipelineCache::GetGraphicsPipeline(const GraphicsPipelineDescription& description)
+{
+	const auto it = s_Context->GraphicsPipelines.find(description);
+	if (it != s_Context->GraphicsPipelines.end())
+		return it->second;
+
+	const VkPipeline pipeline = CreateGraphicsPipeline(description);
+	s_Context->GraphicsPipelines.emplace(description, pipeline);
+	return pipeline;
+}
+
+VkPipeline VulkanPipelineCache::RequestGraphicsPipeline(const GraphicsPipelineDescription& description)
+{
+	const auto it = s_Context->GraphicsPipelines.find(description);
+	if (it != s_Context->GraphicsPipelines.end())
+		return it->second;
+
+	if (s_Context->CompileThreads.empty())
+		return GetGraphicsPipeline(description);
+
+	{
+		std::lock_guard lock(s_Context->CompileMutex);
+		if (!s_Context->PendingPipelines.insert(description).second)
+			return nullptr;
+
+		s_Context->CompileQueue.push_back({ description, std::chrono::steady_clock::now() });
+		s_Context->CompileStats.RequestedCount++;
+	}
+
+	s_Context->CompileRequested.notify_one();
+	return nullptr;
+}
+
+uint32_t VulkanPipelineCache::CommitCompiledPipelines()
+{
+	std::lock_guard lock(s_Context->CompileMutex);
+
+	const uint32_t committedCount = (uint32_t)s_Context->CompiledPipelines.size();
+
+	for (auto& [description, pipeline] : s_Context->CompiledPipelines)
+	{
+		s_Context->PendingPipelines.erase(description);
+
+		// GetGraphicsPipeline may have built the same description in the meantime.
+		// Failed builds are kept as null so they aren't requested over and over
+		const auto [it, inserted] = s_Context->GraphicsPipelines.emplace(description, pipeline);
+		if (!inserted)
+			vkDestroyPipeline(s_Context->LogicalDevice, pipeline, nullptr);
+	}
+
+	s_Context->CompiledPipelines.clear();
+	return committedCount;
+}
+
+bool VulkanPipelineCache::HasGraphicsPipelineFailed(const GraphicsPipelineDescription& description)
+{
+	const auto it = s_Context->GraphicsPipelines.find(description);
+	return it != s_Context->GraphicsPipelines.end() && it->second == nullptr;
+}
+
+void VulkanPipelineCache::CompileLoop()
+{
+	PROFILE_THREAD_NAME("Pipeline compile");
+
+	while (true)
+	{
+		PipelineCacheContext::CompileRequest request;
+
+		{
+			std::unique_lock lock(s_Context->CompileMutex);
+			s_Context->CompileRequested.wait(lock, [] { return s_Context->StopCompiling || !s_Context->CompileQueue.empty(); });
+
+			if (s_Context->StopCompiling)
+				return;
+
+			request = s_Context->CompileQueue.front();
+			s_Context->CompileQueue.pop_front();
+		}
+
+		const auto compileStart = std::chrono::steady_clock::now();
+
+		VkPipeline pipeline = nullptr;
+		try
+		{
+			pipeline = CreateGraphicsPipeline(request.Description);
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cerr << "Failed to build a pipeline in the background: " << e.what() << '\n';
+		}
+
+		const auto compileEnd = std::chrono::steady_clock::now();
+		const float compileMs = std::chrono::duration<float, std::milli>(compileEnd - compileStart).count();
+		const float latencyMs = std::chrono::duration<float, std::milli>(compileEnd - request.RequestTime).count();
+
+		std::lock_guard lock(s_Context->CompileMutex);
+		s_Context->CompiledPipelines.emplace_back(request.Description, pipeline);
+
+		PipelineCompileStats& stats = s_Context->CompileStats;
+		if (pipeline == nullptr)
+		{
+			stats.FailedCount++;
+			continue;
+		}
+
+		stats.CompiledCount++;
+		stats.MaxCompileMs = std::max(stats.MaxCompileMs, compileMs);
+		stats.MaxLatencyMs = std::max(stats.MaxLatencyMs, latencyMs);
+		s_Context->TotalCompileMs += compileMs;
+		s_Context->TotalLatencyMs += latencyMs;
+	}
+}
+
+VkPipeline VulkanPipelineCache::CreateGraphicsPipeline(const GraphicsPipelineDescription& description)
+{
+	PROFILE_FUNCTION();
+
+	VulkanShader* shader = description.Shader;
+
+	VkShaderModule vertexShaderModule;
+	Utils::CreateShaderModule(shader->GetShaderBinary(VulkanShader::ShaderType::Vertex), s_Context->LogicalDevice, vertexShaderModule);
+
+	VkShaderModule fragShaderModule;
+	Utils::CreateShaderModule(shader->GetShaderBinary(VulkanShader::ShaderType::Fragment), s_Context->LogicalDevice, fragShaderModule);
+
+	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
+	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertexShaderCreateInfo.module = vertexShaderModule;
+	vertexShaderCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
+	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragmentShaderCreateInfo.module = fragShaderModule;
+	fragmentShaderCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+
+	const VkVertexInputBindingDescription bindingDescriptions[] = {
+		Utils::GetBindingDescription<Utils::PACKED_VERTEX_LAYOUT>(0, VK_VERTEX_INPUT_RATE_VERTEX),
+		Utils::GetBindingDescription<Utils::INSTANCE_LAYOUT>(1, VK_VERTEX_INPUT_RATE_INSTANCE)
+	};
+
+	// The instance attributes come right after the vertex ones, Shader.vert declares them in the same order
+	constexpr auto vertexAttributes = Utils::GetAttributeDescriptions<Utils::PACKED_VERTEX_LAYOUT>(0, 0);
+	constexpr auto instanceAttributes = Utils::GetAttributeDescriptions<Utils::INSTANCE_LAYOUT>(1, (uint32_t)vertexAttributes.size());
+
+	VkVertexInputAttributeDescription attributeDescriptions[vertexAttributes.size() + instanceAttributes.size()];
+	std::copy(vertexAttributes.begin(), vertexAttributes.end(), attributeDescriptions);
+	std::copy(instanceAttributes.begin(), instanceAttributes.end(), attributeDescriptions + vertexAttributes.size());
+
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = (uint32_t)std::size(bindingDescriptions);
+	vertexInputCreateInfo.pVertexBindingDescriptions = bindingDescriptions;
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t)std::size(attributeDescriptions);
+	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = description.Topology;
+	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	// Set when recording
+	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = nullptr;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = nullptr;
+
+	constexpr VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCreateInfo.dynamicStateCount = (uint32_t)std::size(dynamicStates);
+	dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
+	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+	rasterizerCreateInfo.polygonMode = description.PolygonMode;
+	rasterizerCreateInfo.lineWidth = 1.0f;
+	rasterizerCreateInfo.cullMode = description.CullMode;
+	rasterizerCreateInfo.frontFace = description.FrontFace;
+	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
+	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+	multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blendAttachmentState = {};
+	blendAttachmentState.blendEnable = description.BlendEnable ? VK_TRUE : VK_FALSE;
+	blendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	// Blending equation: (srcColorBlendFactor * newColor) colorBlendOp (dstColorBlendFaction * oldColor)
+	blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+	// (VK_BLEND_FACTOR_SRC_ALPHA * newColor) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * oldColor)
+	// (newColorAlpha * newColor) + ((1- newColorAlpha) * oldColor)
+
+	blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+	// (1 * newAlpha) + (0 * oldAlpha) = newAlpha
+
+	VkPipelineColorBlendStateCreateInfo blendingCreateInfo = {};
+	blendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blendingCreateInfo.logicOpEnable = VK_FALSE;
+	blendingCreateInfo.attachmentCount = 1;
+	blendingCreateInfo.pAttachments = &blendAttachmentState;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = 2;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &blendingCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = nullptr;
+	pipelineCreateInfo.layout = description.Layout;
+	pipelineCreateInfo.renderPass = description.RenderPass;
+	pipelineCreateInfo.subpass = description.Subpass;
+
+	pipelineCreateInfo.basePipelineHandle = nullptr;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	const VkPipeline pipeline = CreateGraphicsPipeline(shader->GetName(), pipelineCreateInfo);
+
+	vkDestroyShaderModule(s_Context->LogicalDevice, fragShaderModule, nullptr);
+	vkDestroyShaderModule(s_Context->LogicalDevice, vertexShaderModule, nullptr);
+
+	return pipeline;
+}
+
+VkPipeline VulkanPipelineCache::CreateGraphicsPipeline(const std::string& name, VkGraphicsPipelineCreateInfo& createInfo)
+{
+	VkPipelineCreationFeedbackEXT feedback = {};
+
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackCreateInfo = {};
+	feedbackCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackCreateInfo.pNext = createInfo.pNext;
+	feedbackCreateInfo.pPipelineCreationFeedback = &feedback;
+
+	if (s_Context->CreationFeedback)
+		createInfo.pNext = &feedbackCreateInfo;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	VkPipeline pipeline;
+	const VkResult result = vkCreateGraphicsPipelines(s_Context->LogicalDevice, s_Context->Cache, 1, &createInfo, nullptr, &pipeline);
+
+	const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	createInfo.pNext = feedbackCreateInfo.pNext;
+
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Graphics Pipeline");
+
+	ReportCreation(name, feedback, elapsedMs);
+	return pipeline;
+}
+
+VkPipeline VulkanPipelineCache::CreateComputePipeline(const std::string& name, VkComputePipelineCreateInfo& createInfo)
+{
+	VkPipelineCreationFeedbackEXT feedback = {};
+
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackCreateInfo = {};
+	feedbackCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackCreateInfo.pNext = createInfo.pNext;
+	feedbackCreateInfo.pPipelineCreationFeedback = &feedback;
+
+	if (s_Context->CreationFeedback)
+		createInfo.pNext = &feedbackCreateInfo;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	VkPipeline pipeline;
+	const VkResult result = vkCreateComputePipelines(s_Context->LogicalDevice, s_Context->Cache, 1, &createInfo, nullptr, &pipeline);
+
+	const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	createInfo.pNext = feedbackCreateInfo.pNext;
+
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Compute Pipeline");
+
+	ReportCreation(name, feedback, elapsedMs);
+	return pipeline;
+}
+
+uint32_t VulkanPipelineCache::GetHitCount()
+{
+	return s_Context->HitCount;
+}
+
+uint32_t VulkanPipelineCache::GetMissCount()
+{
+	return s_Context->MissCount;
+}
+
+uint32_t VulkanPipelineCache::GetGraphicsPipelineCount()
+{
+	return (uint32_t)s_Context->GraphicsPipelines.size();
+}
+
+PipelineCompileStats VulkanPipelineCache::GetCompileStats()
+{
+	std::lock_guard lock(s_Context->CompileMutex);
+
+	PipelineCompileStats stats = s_Context->CompileStats;
+	if (stats.CompiledCount > 0)
+	{
+		stats.AverageCompileMs = s_Context->TotalCompileMs / (float)stats.CompiledCount;
+		stats.AverageLatencyMs = s_Context->TotalLatencyMs / (float)stats.CompiledCount;
+	}
+
+	return stats;
+}
+
+bool VulkanPipelineCache::IsCompatible(const std::string& data)
+{
+	if (data.size() < CACHE_HEADER_SIZE)
+		return false;
+
+	uint32_t headerSize, headerVersion, vendorID, deviceID;
+	memcpy(&headerSize, data.data() + 0, sizeof(uint32_t));
+	memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+	memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+	memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+
+	const VkPhysicalDeviceProperties& properties = s_Context->DeviceProperties;
+
+	return headerSize >= CACHE_HEADER_SIZE && headerSize <= data.size()
+		&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& vendorID == properties.vendorID
+		&& deviceID == properties.deviceID
+		&& memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void VulkanPipelineCache::Save()
+{
+	if (s_Context->Filepath.empty())
+		return;
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(s_Context->LogicalDevice, s_Context->Cache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return;
+
+	std::string data(size, '\0');
+	if (vkGetPipelineCacheData(s_Context->LogicalDevice, s_Context->Cache, &size, data.data()) != VK_SUCCESS)
+		return;
+
+	// Written next to the cache and renamed over it, a crash mid write leaves the previous cache untouched
+	const std::string tempFilepath = s_Context->Filepath + ".tmp";
+
+	{
+		std::ofstream out(tempFilepath, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(data.data(), (std::streamsize)size);
+		out.close();
+
+		if (out.fail())
+		{
+			std::cerr << "Failed to write pipeline cache to '" << tempFilepath << "'\n";
+			std::filesystem::remove(tempFilepath);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFilepath, s_Context->Filepath, error);
+
+	if (error)
+	{
+		std::cerr << "Failed to replace pipeline cache '" << s_Context->Filepath << "': " << error.message() << '\n';
+		std::filesystem::remove(tempFilepath, error);
+	}
+}
+
+void VulkanPipelineCache::ReportCreation(const std::string& name, const VkPipelineCreationFeedbackEXT& feedback, float elapsedMs)
+{
+	// Background builds report too
+	std::lock_guard lock(s_Context->CompileMutex);
+
+	std::cout << "Pipeline '" << name << "' created in " << elapsedMs << " ms";
+
+	// Without feedback the driver's own timing and cache result aren't known
+	if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+	{
+		const bool hit = feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+		if (hit)
+			s_Context->HitCount++;
+		else
+			s_Context->MissCount++;
+
+		std::cout << ", cache " << (hit ? "hit" : "miss") << " (" << (float)feedback.duration / 1000000.0f << " ms in the driver)";
+	}
+
+	std::cout << '\n';
+}
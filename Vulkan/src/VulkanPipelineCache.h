@@ -0,0 +1,103 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <vulkan/vulkan.h>
+#pragma warning(pop)
+
+#include <string>
+
+class VulkanShader;
+
+// Everything a graphics pipeline is built from, identical descriptions share one pipeline.
+// Viewport and scissor are dynamic state so the pipeline doesn't depend on the resolution
+struct GraphicsPipelineDescription
+{
+	// Needs vertex and fragment stages, the shader library keeps it alive
+	VulkanShader* Shader = nullptr;
+	VkPipelineLayout Layout = nullptr;
+	VkRenderPass RenderPass = nullptr;
+	uint32_t Subpass = 0;
+
+	VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode PolygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace FrontFace = VK_FRONT_FACE_CLOCKWISE;
+	bool BlendEnable = true;
+
+	uint64_t Hash() const;
+	bool operator==(const GraphicsPipelineDescription&) const = default;
+
+	struct Hasher
+	{
+		size_t operator()(const GraphicsPipelineDescription& description) const { return (size_t)description.Hash(); }
+	};
+};
+
+struct PipelineCacheCreateInfo
+{
+	VkPhysicalDevice PhysicalDevice;
+	VkDevice LogicalDevice;
+	// Empty keeps the cache in memory only
+	std::string Filepath;
+	// VK_EXT_pipeline_creation_feedback is enabled, tells whether each pipeline was found in the cache
+	bool CreationFeedback;
+	// Threads building requested pipelines in the background, 0 builds them on request
+	uint32_t CompileThreadCount;
+};
+
+struct PipelineCompileStats
+{
+	// Pipelines sent to the background threads and how many of them are done
+	uint32_t RequestedCount = 0;
+	uint32_t CompiledCount = 0;
+	uint32_t FailedCount = 0;
+	// Times a draw would have stalled on a pipeline build, filled in by the renderer
+	uint64_t HitchesAvoided = 0;
+
+	// Time spent inside vkCreateGraphicsPipelines
+	float AverageCompileMs = 0.0f;
+	float MaxCompileMs = 0.0f;
+	// From the request until the pipeline is built, including the time spent queued
+	float AverageLatencyMs = 0.0f;
+	float MaxLatencyMs = 0.0f;
+};
+
+// Keeps every pipeline the renderer creates in one VkPipelineCache that is loaded from disk on Init and written back on Shutdown.
+// Data saved by a different driver or GPU is discarded instead of being handed to the driver.
+// Graphics pipelines are also deduplicated at runtime by their description, the cache owns them and destroys them on Shutdown.
+class VulkanPipelineCache
+{
+public:
+	static void Init(const PipelineCacheCreateInfo& createInfo);
+	static void Shutdown();
+
+	// Returns the pipeline built from an identical description if there is one, otherwise builds it
+	static VkPipeline GetGraphicsPipeline(const GraphicsPipelineDescription& description);
+
+	// Same as GetGraphicsPipeline but never builds on the calling thread. Unknown descriptions are queued
+	// for the background threads and null is returned until CommitCompiledPipelines picks up the result
+	static VkPipeline RequestGraphicsPipeline(const GraphicsPipelineDescription& description);
+	// Makes the pipelines built in the background since the last call available, meant to be called between frames.
+	// Returns how many there were
+	static uint32_t CommitCompiledPipelines();
+	// Whether a committed background build of the description failed, RequestGraphicsPipeline keeps returning null for it
+	static bool HasGraphicsPipelineFailed(const GraphicsPipelineDescription& description);
+
+	// Create the pipeline through the cache and report whether it was a hit and how long it took, the caller owns it
+	static VkPipeline CreateComputePipeline(const std::string& name, VkComputePipelineCreateInfo& createInfo);
+
+	// Driver cache results, only counted when creation feedback is available
+	static uint32_t GetHitCount();
+	static uint32_t GetMissCount();
+	// Unique graphics pipelines built so far
+	static uint32_t GetGraphicsPipelineCount();
+	static PipelineCompileStats GetCompileStats();
+
+private:
+	static VkPipeline CreateGraphicsPipeline(const GraphicsPipelineDescription& description);
+	static VkPipeline CreateGraphicsPipeline(const std::string& name, VkGraphicsPipelineCreateInfo& createInfo);
+	static void CompileLoop();
+	static bool IsCompatible(const std::string& data);
+	static void Save();
+	static void ReportCreation(const std::string& name, const VkPipelineCreationFeedbackEXT& feedback, float elapsedMs);
+};
@@ -3,19 +3,74 @@
 #include "VulkanUtils.h"
 #include "VulkanShader.h"
 #include "VulkanMesh.h"
+#include "VulkanGeometryPool.h"
+#include "VulkanUploader.h"
+#include "VulkanPipelineCache.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 #pragma warning(push, 0)
 #include <GLFW/glfw3.h>
 #pragma warning(pop)
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <unordered_set>
 
 
+struct DrawCommand
+{
+	VulkanRenderer::MeshHandle Mesh;
+	VulkanRenderer::MaterialHandle Material;
+	// A level of detail or the visible meshlets of one
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	uint32_t FirstInstance;
+	uint32_t InstanceCount;
+
+	bool operator==(const DrawCommand&) const = default;
+};
+
+// Per mesh entry read by the cull pass, layouts match Cull.comp
+struct GpuMeshData
+{
+	glm::vec4 BoundingSphere;
+	int32_t VertexOffset;
+	// 1 for 16 bit indices, their draws go to the first half of the draw command buffer
+	uint32_t ShortIndices;
+	uint32_t LodCount;
+	uint32_t Padding;
+	MeshLod Lods[Utils::MAX_MESH_LODS];
+};
+
+struct CullData
+{
+	glm::vec4 FrustumPlanes[6];
+	// Row of the view projection that gives the clip space w
+	glm::vec4 ClipW;
+	uint32_t ObjectCount;
+	// Where the draws of 32 bit meshes start in the draw command buffer
+	uint32_t WideDrawOffset;
+	float LodScale;
+	float LodErrorThreshold;
+};
+
 struct RendererContext
 {
 	Ref<Window> Window;
+	bool Headless = false;
+	VkExtent2D HeadlessExtent{};
+	bool GpuDriven = false;
+	bool DrawCompilingMaterialsWithDefault = true;
+	// VK_EXT_pipeline_creation_feedback is enabled
+	bool PipelineCreationFeedback = false;
+	// fillModeNonSolid is enabled, wireframe materials are allowed
+	bool WireframeSupported = false;
+	// pipelineStatisticsQuery and inheritedQueries are enabled, the statistics query spans the secondary command buffers
+	bool PipelineStatisticsSupported = false;
 	Utils::QueueFamilyIndices DeviceQueueFamilyIndices{};
 	Utils::SwapChainDetails SwapChainDetails{};
 
@@ -25,26 +80,372 @@ struct RendererContext
 	VkDevice LogicalDevice = nullptr;
 	VkQueue GraphicsQueue = nullptr;
 	VkQueue PresentationQueue = nullptr;
+	VkQueue TransferQueue = nullptr;
 	VkSwapchainKHR SwapChain = nullptr;
 	VkPipelineLayout PipelineLayout = nullptr;
 	VkRenderPass RenderPass = nullptr;
+	// The default material's pipeline
 	VkPipeline GraphicsPipeline = nullptr;
 	VkCommandPool GraphicsCommandPool = nullptr;
 
+	// Only created when GPU driven
+	VkDescriptorSetLayout CullingDescriptorSetLayout = nullptr;
+	VkDescriptorPool CullingDescriptorPool = nullptr;
+	VkPipelineLayout CullingPipelineLayout = nullptr;
+	VkPipeline CullingPipeline = nullptr;
+
 	VkFormat SwapChainImageFormat = VK_FORMAT_UNDEFINED;
 	VkExtent2D SwapChainExtent{};
 	std::vector<Utils::SwapChainImage> SwapChainImages{};
 	std::vector<VkFramebuffer> SwapChainFramebuffers{};
-	std::vector<VkCommandBuffer> CommandBuffers{};
+	// Acquire or present reported the swapchain no longer matches the surface
+	bool SwapChainOutOfDate = false;
+
+	// Replaced swapchains and everything created from them, destroyed once FrameTimeline reaches TimelineValue
+	struct RetiredSwapChain
+	{
+		uint64_t TimelineValue;
+		VkSwapchainKHR SwapChain;
+		std::vector<Utils::SwapChainImage> Images;
+		std::vector<VkFramebuffer> Framebuffers;
+		std::vector<VkSemaphore> RenderFinishedSemaphores;
+	};
+
+	std::vector<RetiredSwapChain> RetiredSwapChains{};
+
+	// Command buffers are recorded per frame in flight, each frame owns its pool so it can be reset as a whole
+	struct FrameData
+	{
+		// FrameTimeline value signaled by the frame's last submit, reached once everything below is free again
+		uint64_t TimelineValue = 0;
+
+		VkCommandPool CommandPool = nullptr;
+		VkCommandBuffer CommandBuffer = nullptr;
+
+		// One pool per recording task, a task is only ever recorded by one thread at a time
+		std::vector<VkCommandPool> SecondaryCommandPools{};
+		std::vector<VkCommandBuffer> SecondaryCommandBuffers{};
+
+		// Host visible, rewritten with the frame's instances every Draw
+		VkBuffer InstanceBuffer = nullptr;
+		VulkanAllocation InstanceBufferAllocation{};
+		uint32_t InstanceCapacity = 0;
+
+		// GPU driven only. Every instance is an object, the host visible buffers are read by the cull pass
+		// and the device local ones are written by it, all of them grow with InstanceCapacity except the mesh table
+		VkBuffer ObjectMeshBuffer = nullptr;
+		VulkanAllocation ObjectMeshBufferAllocation{};
+		VkBuffer MeshDataBuffer = nullptr;
+		VulkanAllocation MeshDataBufferAllocation{};
+		uint32_t MeshDataCapacity = 0;
+		uint64_t MeshDataGeneration = UINT64_MAX;
+		VkBuffer CullDataBuffer = nullptr;
+		VulkanAllocation CullDataBufferAllocation{};
+		VkBuffer DrawCommandBuffer = nullptr;
+		VulkanAllocation DrawCommandBufferAllocation{};
+		VkBuffer DrawCountBuffer = nullptr;
+		VulkanAllocation DrawCountBufferAllocation{};
+		VkDescriptorSet CullingDescriptorSet = nullptr;
+
+		// Set when a buffer the command buffer references is replaced, it has to be recorded again
+		bool BuffersRecreated = false;
+
+		// The draws recorded into the secondary command buffers don't depend on the swapchain image. When only the image changed
+		// the primary is recorded again and executes them as they are, their zones keep the first queries
+		bool SecondariesRecorded = false;
+		uint32_t SecondaryZoneCount = 0;
+		DrawCounters SecondaryCounters{};
+
+		// What the command buffer was last recorded with, if nothing changed it's submitted again as is
+		std::vector<DrawCommand> RecordedDrawList{};
+		uint32_t RecordedImageIndex = UINT32_MAX;
+		uint64_t RecordedMeshGeneration = UINT64_MAX;
+		uint64_t RecordedPipelineGeneration = UINT64_MAX;
+		glm::mat4 RecordedViewProjection{};
+		DrawCounters RecordedCounters{};
+	};
 
-	VkSemaphore ImageAvailableSemaphores[Utils::MAX_FRAME_DRAWS]{};
-	VkSemaphore RenderFinishedSemaphores[Utils::MAX_FRAME_DRAWS]{};
-	VkFence DrawFences[Utils::MAX_FRAME_DRAWS]{};
+	uint32_t FramesInFlight = Utils::DEFAULT_FRAMES_IN_FLIGHT;
+	std::vector<FrameData> Frames{};
+
+	VulkanGeometryPool GeometryPool{};
+
+	// Null when recording single threaded
+	Scope<ThreadPool> RecordingThreadPool = nullptr;
+
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	Scope<FramePacer> Pacer = nullptr;
+	bool JustInTimePacing = false;
+	// Set by WaitForNextFrame until the frame is drawn
+	bool FrameStarted = false;
+	// Null without VK_KHR_present_wait, frames are then complete once the GPU is done with them
+	PFN_vkWaitForPresentKHR WaitForPresent = nullptr;
+
+	bool OptimizeMeshes = false;
+	MeshOptimizerSettings OptimizerSettings{};
+	MeshOptimizationStats MeshOptimization{};
+
+	bool GenerateLods = false;
+	MeshLodSettings LodSettings{};
+	float LodErrorThreshold = 1.0f;
+
+	bool BuildMeshlets = false;
+
+	// Headless render targets, SwapChainImages holds their image views
+	std::vector<VulkanAllocation> OffscreenImagesAllocations{};
+	VkBuffer ReadbackBuffer = nullptr;
+	VulkanAllocation ReadbackBufferAllocation{};
+	uint32_t LastDrawnImage = UINT32_MAX;
+
+	// Every frame signals the frame number + 1 once the GPU is done with it, it replaces a fence per frame
+	VkSemaphore FrameTimeline = nullptr;
+	// Acquire and present only take binary semaphores. ImageAvailable is per frame in flight and RenderFinished per image,
+	// an image's semaphore is only signaled again once the image has been presented and acquired again
+	std::vector<VkSemaphore> ImageAvailableSemaphores{};
+	std::vector<VkSemaphore> RenderFinishedSemaphores{};
+	// FrameTimeline value of the last frame that rendered into each image
+	std::vector<uint64_t> ImagesInFlight{};
 };
 
 static RendererContext* s_Context = nullptr;
 static uint32_t s_CurrentFrame = 0;
+static uint64_t s_FrameNumber = 0;
+
 static std::vector<VulkanMesh> s_Meshes;
+static std::vector<VulkanRenderer::MeshHandle> s_FreeMeshHandles;
+// Meshes destroyed by the user are kept alive until the frames that might be using them are done
+static std::vector<std::pair<uint64_t, VulkanMesh>> s_RetiredMeshes;
+// Bumped every time a mesh is created or destroyed so handles that get reused invalidate recorded frames
+static uint64_t s_MeshGeneration = 0;
+
+static std::vector<DrawCommand> s_DrawList;
+static std::vector<Utils::InstanceData> s_Instances;
+// Mesh of every instance, only filled when GPU driven
+static std::vector<uint32_t> s_ObjectMeshes;
+static glm::mat4 s_ViewProjection = glm::mat4(1.0f);
+static float s_LastRecordTimeMs = 0.0f;
+// Gathered while submitting, the frame's counters are only reset once the frame has started
+static uint32_t s_ClustersTested = 0;
+static uint32_t s_ClustersCulled = 0;
+static std::vector<uint8_t> s_ClusterVisibility;
+
+// Indexed by material handle, a null pipeline is still being compiled
+static std::vector<GraphicsPipelineDescription> s_Materials;
+static std::vector<VkPipeline> s_MaterialPipelines;
+// Whether a draw already went ahead without the material's pipeline, each material is only counted once
+static std::vector<bool> s_MaterialFallbackCounted;
+static uint32_t s_CompilingMaterialCount = 0;
+// Bumped when compiled pipelines are swapped in so frames recorded with the fallback are recorded again
+static uint64_t s_PipelineGeneration = 0;
+static uint64_t s_HitchesAvoided = 0;
+
+// Of the frame being drawn and the last one submitted
+static FrameCounters s_FrameCounters;
+static FrameCounters s_LastFrameCounters;
+static uint64_t s_LastUploadedBytes = 0;
+
+static void DestroyRetiredSwapChain(RendererContext::RetiredSwapChain& retired)
+{
+	for (auto& semaphore : retired.RenderFinishedSemaphores)
+		vkDestroySemaphore(s_Context->LogicalDevice, semaphore, nullptr);
+
+	for (auto& framebuffer : retired.Framebuffers)
+		vkDestroyFramebuffer(s_Context->LogicalDevice, framebuffer, nullptr);
+
+	for (auto& image : retired.Images)
+		vkDestroyImageView(s_Context->LogicalDevice, image.ImageView, nullptr);
+
+	vkDestroySwapchainKHR(s_Context->LogicalDevice, retired.SwapChain, nullptr);
+}
+
+static std::vector<VkSemaphore> CreateSemaphores(size_t count)
+{
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	std::vector<VkSemaphore> semaphores(count);
+	for (auto& semaphore : semaphores)
+	{
+		if (vkCreateSemaphore(s_Context->LogicalDevice, &semaphoreCreateInfo, nullptr, &semaphore) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Semaphore!");
+	}
+
+	return semaphores;
+}
+
+// Blocks until the frame timeline reaches the value, the time counts as the current frame's GPU wait
+static void WaitForFrameTimeline(uint64_t value)
+{
+	const auto waitStart = std::chrono::steady_clock::now();
+	Utils::WaitForTimeline(s_Context->LogicalDevice, s_Context->FrameTimeline, value);
+	s_FrameCounters.GpuWaitMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+}
+
+// Ends a frame that couldn't be presented, its draws are dropped the same way a drawn frame's are
+static void SkipFrame()
+{
+	s_DrawList.clear();
+	s_Instances.clear();
+	s_ObjectMeshes.clear();
+	s_ClustersTested = 0;
+	s_ClustersCulled = 0;
+
+	s_Context->Pacer->EndFrame();
+	s_Context->FrameStarted = false;
+}
+
+// Polled without blocking, a frame's latency is measured from when it started until the first poll that sees it complete
+static void CompletePacedFrames()
+{
+	FramePacer& pacer = *s_Context->Pacer;
+
+	if (s_Context->WaitForPresent == nullptr)
+	{
+		pacer.CompleteFrames(Utils::GetTimelineValue(s_Context->LogicalDevice, s_Context->FrameTimeline));
+		return;
+	}
+
+	// Presents complete in order, so the oldest one not done yet ends the search
+	for (uint64_t frameId = pacer.GetOldestPendingFrame(); frameId != 0; frameId = pacer.GetOldestPendingFrame())
+	{
+		if (s_Context->WaitForPresent(s_Context->LogicalDevice, s_Context->SwapChain, frameId, 0) != VK_SUCCESS)
+			break;
+
+		pacer.CompleteFrames(frameId);
+	}
+}
+
+// Replaces the buffer with a new one, its contents are lost
+static void RecreateBuffer(VkBuffer& buffer, VulkanAllocation& allocation, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+	vkDestroyBuffer(s_Context->LogicalDevice, buffer, nullptr);
+	VulkanAllocator::Free(allocation);
+
+	Utils::CreateBufferInfo bufferInfo = {
+		bufferInfo.LogicalDevice = s_Context->LogicalDevice,
+		bufferInfo.BufferSize = size,
+		bufferInfo.BufferUsage = usage,
+		bufferInfo.BufferProperties = properties,
+		bufferInfo.Buffer = &buffer,
+		bufferInfo.BufferAllocation = &allocation
+	};
+
+	Utils::CreateBuffer(bufferInfo);
+}
+
+static void DestroyBuffer(VkBuffer& buffer, VulkanAllocation& allocation)
+{
+	vkDestroyBuffer(s_Context->LogicalDevice, buffer, nullptr);
+	VulkanAllocator::Free(allocation);
+	buffer = nullptr;
+}
+
+// Gribb-Hartmann, with Vulkan's 0 to 1 depth range. The planes are normalized so distances can be compared against radii
+static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 outPlanes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	outPlanes[0] = rows[3] + rows[0];
+	outPlanes[1] = rows[3] - rows[0];
+	outPlanes[2] = rows[3] + rows[1];
+	outPlanes[3] = rows[3] - rows[1];
+	outPlanes[4] = rows[2];
+	outPlanes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++)
+		outPlanes[i] /= glm::length(glm::vec3(outPlanes[i]));
+}
+
+// Pixels a unit of world space covers at a clip space w of 1. The y row of the projection only scales the view's y axis, which has unit length
+static float GetLodScale(const glm::mat4& viewProjection)
+{
+	const float viewportHeight = (float)s_Context->SwapChainExtent.height;
+	return glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1])) * viewportHeight * 0.5f;
+}
+
+// Coarsest level whose error covers at most LodErrorThreshold pixels, same as Cull.comp
+static uint32_t SelectLod(const VulkanMesh& mesh, const glm::mat4& transform, float lodScale)
+{
+	const glm::vec4& sphere = mesh.GetBoundingSphere();
+	const glm::vec4 clip = s_ViewProjection * (transform * glm::vec4(glm::vec3(sphere), 1.0f));
+
+	// Behind the camera the size can't be projected, it's also what's closest to it
+	if (clip.w <= 0.0f)
+		return 0;
+
+	const float scale = std::max(std::max(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1]))), glm::length(glm::vec3(transform[2])));
+	const float projectedRadius = sphere.w * scale * lodScale / clip.w;
+
+	uint32_t lod = mesh.GetLodCount() - 1;
+	while (lod > 0 && mesh.GetLodError(lod) * projectedRadius > s_Context->LodErrorThreshold)
+		lod--;
+
+	return lod;
+}
+
+// The previous draw's instances are always the last ones in s_Instances, so the new ones extend its range
+static void AppendDraw(VulkanRenderer::MeshHandle mesh, VulkanRenderer::MaterialHandle material, uint32_t firstIndex, uint32_t indexCount,
+	const Utils::InstanceData* instances, uint32_t instanceCount)
+{
+	const DrawCommand* last = s_DrawList.empty() ? nullptr : &s_DrawList.back();
+	if (last != nullptr && last->Mesh == mesh && last->Material == material && last->FirstIndex == firstIndex && last->IndexCount == indexCount)
+		s_DrawList.back().InstanceCount += instanceCount;
+	else
+		s_DrawList.push_back({ mesh, material, firstIndex, indexCount, (uint32_t)s_Instances.size(), instanceCount });
+
+	s_Instances.insert(s_Instances.end(), instances, instances + instanceCount);
+}
+
+// Draws the instance once per run of consecutive meshlets that survive culling, every draw reads the same instance
+static void AppendClusterDraws(VulkanRenderer::MeshHandle mesh, VulkanRenderer::MaterialHandle material, const Utils::InstanceData& instance,
+	const glm::vec4 frustumPlanes[6], const glm::vec4& camera, bool cullBackfaces)
+{
+	const VulkanMesh& vulkanMesh = s_Meshes[mesh];
+	const ClusterBounds& clusters = vulkanMesh.GetClusters();
+	const uint32_t clusterCount = clusters.GetCount();
+
+	s_ClusterVisibility.resize(clusterCount);
+	const uint32_t visibleCount = Utils::CullClusters(clusters, instance.Transform, frustumPlanes, camera, cullBackfaces, s_ClusterVisibility.data());
+
+	s_ClustersTested += clusterCount;
+	s_ClustersCulled += clusterCount - visibleCount;
+
+	if (visibleCount == 0)
+		return;
+
+	if (visibleCount == clusterCount)
+	{
+		AppendDraw(mesh, material, vulkanMesh.GetFirstIndex(), vulkanMesh.GetIndicesCount(), &instance, 1);
+		return;
+	}
+
+	const uint32_t instanceIndex = (uint32_t)s_Instances.size();
+	s_Instances.push_back(instance);
+
+	uint32_t rangeStart = 0;
+	uint32_t rangeCount = 0;
+	for (uint32_t i = 0; i < clusterCount; i++)
+	{
+		if (!s_ClusterVisibility[i])
+			continue;
+
+		if (rangeCount > 0 && rangeStart + rangeCount == clusters.FirstIndex[i])
+		{
+			rangeCount += clusters.IndexCount[i];
+			continue;
+		}
+
+		if (rangeCount > 0)
+			s_DrawList.push_back({ mesh, material, rangeStart, rangeCount, instanceIndex, 1 });
+
+		rangeStart = clusters.FirstIndex[i];
+		rangeCount = clusters.IndexCount[i];
+	}
+
+	s_DrawList.push_back({ mesh, material, rangeStart, rangeCount, instanceIndex, 1 });
+}
 
 #if defined(VULKAN_DEBUG)
 	#include "VulkanDebug.h"
@@ -71,64 +472,111 @@ static std::vector<VulkanMesh> s_Meshes;
 	#define DestroyDebugCallback()
 #endif
 
-bool VulkanRenderer::Init(Ref<Window> windowContext)
+bool VulkanRenderer::Init(const RendererCreateInfo& createInfo)
 {
+	PROFILE_FUNCTION();
+
 	if (s_Context != nullptr)
 		return true;
 
 	try
 	{
-		s_Context = new RendererContext{ std::move(windowContext) };
+		s_Context = new RendererContext{ createInfo.Window, createInfo.Headless, { createInfo.Width, createInfo.Height }, createInfo.GpuDriven, createInfo.DrawCompilingMaterialsWithDefault };
+		s_Context->FramesInFlight = createInfo.FramesInFlight;
+		s_Context->Frames.resize(s_Context->FramesInFlight);
+		s_Context->PresentMode = createInfo.PresentMode;
+		s_Context->JustInTimePacing = createInfo.JustInTimePacing;
+		s_Context->OptimizeMeshes = createInfo.OptimizeMeshes;
+		s_Context->OptimizerSettings = createInfo.OptimizerSettings;
+		s_Context->GenerateLods = createInfo.GenerateLods;
+		s_Context->LodSettings = createInfo.LodSettings;
+		s_Context->LodErrorThreshold = createInfo.LodErrorThreshold;
+		s_Context->BuildMeshlets = createInfo.BuildMeshlets;
+
+		FramePacerCreateInfo pacerCreateInfo = {
+			pacerCreateInfo.TargetFrameRate = createInfo.TargetFrameRate,
+			pacerCreateInfo.JustInTime = createInfo.JustInTimePacing
+		};
+
+		s_Context->Pacer = CreateScope<FramePacer>(pacerCreateInfo);
+
+		if (!s_Context->Headless && s_Context->Window == nullptr)
+			throw std::runtime_error("A window is required when not running headless!");
+
+		if (s_Context->Headless && (createInfo.Width == 0 || createInfo.Height == 0))
+			throw std::runtime_error("Headless rendering requires a non zero width and height!");
+
+		if (createInfo.FramesInFlight == 0)
+			throw std::runtime_error("At least one frame has to be in flight!");
+
 		CreateInstance(ValidateExtensions());
 		CreateDebugCallback();
-		CreateSurface();
+
+		if (!s_Context->Headless)
+			CreateSurface();
+
 		GetPhysicalDevice();
 		CreateLogicalDevice();
-		CreateSwapChain();
-		CreateRenderPass();
-		CreateGraphicsPipeline();
-		CreateFramebuffers();
-		CreateCommandPool();
-
-		constexpr Utils::VertexData meshVertices[] = {
-			{ { -0.1f, -0.4f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-			{ { -0.1f,  0.4f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
-			{ { -0.9f,  0.4f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
-			{ { -0.9f, -0.4f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+		VulkanAllocator::Init(s_Context->PhysicalDevice, s_Context->LogicalDevice);
+
+		PipelineCacheCreateInfo pipelineCacheCreateInfo = {
+			pipelineCacheCreateInfo.PhysicalDevice = s_Context->PhysicalDevice,
+			pipelineCacheCreateInfo.LogicalDevice = s_Context->LogicalDevice,
+			pipelineCacheCreateInfo.Filepath = createInfo.PipelineCachePath,
+			pipelineCacheCreateInfo.CreationFeedback = s_Context->PipelineCreationFeedback,
+			pipelineCacheCreateInfo.CompileThreadCount = createInfo.PipelineCompileThreadCount
 		};
 
-		constexpr Utils::VertexData meshVertices2[] = {
-			{ {  0.9f, -0.3f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-			{ {  0.9f,  0.3f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
-			{ {  0.1f,  0.3f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
-			{ {  0.1f, -0.3f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
-		};
+		VulkanPipelineCache::Init(pipelineCacheCreateInfo);
+
+		if (createInfo.GpuProfiling)
+		{
+			GpuProfilerCreateInfo gpuProfilerCreateInfo = {
+				gpuProfilerCreateInfo.PhysicalDevice = s_Context->PhysicalDevice,
+				gpuProfilerCreateInfo.LogicalDevice = s_Context->LogicalDevice,
+				gpuProfilerCreateInfo.QueueFamilyIndex = (uint32_t)s_Context->DeviceQueueFamilyIndices.GraphicsFamily,
+				gpuProfilerCreateInfo.FramesInFlight = s_Context->FramesInFlight,
+				gpuProfilerCreateInfo.MaxZonesPerFrame = Utils::MAX_GPU_ZONES_PER_FRAME,
+				gpuProfilerCreateInfo.HistorySize = Utils::GPU_ZONE_HISTORY_SIZE,
+				gpuProfilerCreateInfo.PipelineStatistics = s_Context->PipelineStatisticsSupported
+			};
+
+			VulkanGpuProfiler::Init(gpuProfilerCreateInfo);
+		}
 
-		constexpr uint32_t meshIndices[] = {
-			0, 1, 2,
-			2, 3, 0
+		UploaderCreateInfo uploaderCreateInfo = {
+			uploaderCreateInfo.LogicalDevice = s_Context->LogicalDevice,
+			uploaderCreateInfo.TransferQueue = s_Context->TransferQueue,
+			uploaderCreateInfo.TransferQueueFamilyIndex = (uint32_t)s_Context->DeviceQueueFamilyIndices.TransferFamily,
+			uploaderCreateInfo.GraphicsQueue = s_Context->GraphicsQueue,
+			uploaderCreateInfo.GraphicsQueueFamilyIndex = (uint32_t)s_Context->DeviceQueueFamilyIndices.GraphicsFamily,
+			uploaderCreateInfo.StagingBufferSize = createInfo.StagingBufferSize
 		};
 
-		VulkanMesh::MeshCreateInfo meshCreateInfo = {
-			meshCreateInfo.PhysicalDevice = s_Context->PhysicalDevice,
-			meshCreateInfo.LogicalDevice = s_Context->LogicalDevice,
-			meshCreateInfo.TransferQueue = s_Context->GraphicsQueue,
-			meshCreateInfo.TransferCommandPool = s_Context->GraphicsCommandPool,
-			meshCreateInfo.Vertices = meshVertices,
-			meshCreateInfo.VerticesCount = (uint32_t)std::size(meshVertices),
-			meshCreateInfo.Indices = meshIndices,
-			meshCreateInfo.IndicesCount = (uint32_t)std::size(meshIndices)
+		VulkanUploader::Init(uploaderCreateInfo);
+
+		VulkanGeometryPool::GeometryPoolCreateInfo geometryPoolCreateInfo = {
+			geometryPoolCreateInfo.LogicalDevice = s_Context->LogicalDevice,
+			geometryPoolCreateInfo.VertexCapacity = createInfo.GeometryVertexCapacity,
+			geometryPoolCreateInfo.IndexCapacity = createInfo.GeometryIndexCapacity
 		};
 
-		VulkanMesh::MeshCreateInfo meshCreateInfo2 = meshCreateInfo;
-		meshCreateInfo2.Vertices = meshVertices2;
-		meshCreateInfo2.VerticesCount = (uint32_t)std::size(meshVertices2);
+		s_Context->GeometryPool = VulkanGeometryPool(geometryPoolCreateInfo);
+
+		if (s_Context->Headless)
+			CreateOffscreenTargets();
+		else
+			CreateSwapChain();
+
+		CreateRenderPass();
+		CreateGraphicsPipeline();
 
-		s_Meshes.emplace_back(VulkanMesh(meshCreateInfo));
-		s_Meshes.emplace_back(VulkanMesh(meshCreateInfo2));
+		if (s_Context->GpuDriven)
+			CreateCullingPipeline();
 
-		CreateCommandBuffers();
-		RecordCommands();
+		CreateFramebuffers();
+		CreateCommandPool();
+		CreateCommandBuffers(createInfo.RecordingThreadCount);
 		CreateSynchronization();
 
 		return true;
@@ -141,62 +589,726 @@ bool VulkanRenderer::Init(Ref<Window> windowContext)
 	}
 }
 
+void VulkanRenderer::WaitForNextFrame()
+{
+	PROFILE_FUNCTION();
+
+	if (s_Context->FrameStarted)
+		return;
+
+	s_FrameCounters = {};
+
+	// Nothing can be presented while minimized, sleep on window events instead of spinning through empty frames
+	if (!s_Context->Headless)
+	{
+		GLFWwindow* window = s_Context->Window->GetGLFWWindow();
+		while (s_Context->Window->IsMinimized() && !glfwWindowShouldClose(window))
+			glfwWaitEvents();
+	}
+
+	CompletePacedFrames();
+
+	// Nothing is left queued on the GPU when the frame starts, so it isn't delayed behind older frames
+	if (s_Context->JustInTimePacing)
+	{
+		PROFILE_SCOPE("Wait for GPU idle");
+		WaitForFrameTimeline(s_FrameNumber);
+	}
+
+	// Frames are identified by the timeline value they signal, which is also their present id
+	{
+		PROFILE_SCOPE("Pace frame");
+		s_Context->Pacer->WaitForNextFrame(s_FrameNumber + 1);
+	}
+	s_Context->FrameStarted = true;
+}
+
 void VulkanRenderer::Draw()
 {
-	const auto& imageAvailableSemaphore = s_Context->ImageAvailableSemaphores[s_CurrentFrame];
-	const auto& renderFinishedSemaphore = s_Context->RenderFinishedSemaphores[s_CurrentFrame];
-	const auto& drawFence = s_Context->DrawFences[s_CurrentFrame];
+	PROFILE_FUNCTION();
 
-	vkWaitForFences(s_Context->LogicalDevice, 1, &drawFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(s_Context->LogicalDevice, 1, &drawFence);
+	WaitForNextFrame();
 
-	uint32_t nextImageIndex = 0;
-	vkAcquireNextImageKHR(s_Context->LogicalDevice, s_Context->SwapChain, UINT64_MAX, imageAvailableSemaphore, nullptr, &nextImageIndex);
+	auto& frame = s_Context->Frames[s_CurrentFrame];
+	const VkSemaphore imageAvailableSemaphore = s_Context->Headless ? nullptr : s_Context->ImageAvailableSemaphores[s_CurrentFrame];
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+	{
+		PROFILE_SCOPE("Wait for frame");
+		WaitForFrameTimeline(frame.TimelineValue);
+	}
+
+	VulkanGpuProfiler::CollectResults(s_CurrentFrame);
+
+	// A mesh retired after F frames were submitted can only be used by frames whose values are at most F
+	const uint64_t completedValue = Utils::GetTimelineValue(s_Context->LogicalDevice, s_Context->FrameTimeline);
+	std::erase_if(s_RetiredMeshes, [completedValue](auto& retired)
+	{
+		if (retired.first > completedValue)
+			return false;
+
+		retired.second.Destroy();
+		return true;
+	});
+
+	std::erase_if(s_Context->RetiredSwapChains, [completedValue](auto& retired)
+	{
+		if (retired.TimelineValue > completedValue)
+			return false;
+
+		DestroyRetiredSwapChain(retired);
+		return true;
+	});
+
+	// Pipelines compiled in the background are only swapped in here so a frame never sees a material change halfway through
+	if (s_CompilingMaterialCount > 0 && VulkanPipelineCache::CommitCompiledPipelines() > 0)
+	{
+		for (size_t i = 0; i < s_Materials.size(); i++)
+		{
+			if (s_MaterialPipelines[i] != nullptr)
+				continue;
+
+			s_MaterialPipelines[i] = VulkanPipelineCache::RequestGraphicsPipeline(s_Materials[i]);
+			if (s_MaterialPipelines[i] == nullptr && VulkanPipelineCache::HasGraphicsPipelineFailed(s_Materials[i]))
+			{
+				std::cerr << "Material " << i << " failed to compile, it's drawn with the default material\n";
+				s_MaterialPipelines[i] = s_Context->GraphicsPipeline;
+			}
+
+			if (s_MaterialPipelines[i] != nullptr)
+				s_CompilingMaterialCount--;
+		}
+
+		s_PipelineGeneration++;
+	}
+
+	UploadInstances(s_CurrentFrame);
+
+	if (s_Context->GpuDriven)
+		UploadCullingData(s_CurrentFrame);
+
+	// There is one offscreen image per frame in flight so the wait above already guarantees it's free
+	uint32_t nextImageIndex = s_CurrentFrame;
+
+	if (!s_Context->Headless)
+	{
+		if ((s_Context->SwapChainOutOfDate || s_Context->Window->WasResized()) && !RecreateSwapChain())
+		{
+			SkipFrame();
+			return;
+		}
+
+		PROFILE_SCOPE("Acquire image");
+		const VkResult acquireResult = vkAcquireNextImageKHR(s_Context->LogicalDevice, s_Context->SwapChain, UINT64_MAX, imageAvailableSemaphore, nullptr, &nextImageIndex);
+
+		// Nothing was acquired so the semaphore isn't signaled, the frame is dropped and the next one uses the new swapchain
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			s_Context->SwapChainOutOfDate = true;
+			SkipFrame();
+			return;
+		}
+
+		// A suboptimal swapchain can still be presented to, it's replaced before the next frame
+		if (acquireResult == VK_SUBOPTIMAL_KHR)
+			s_Context->SwapChainOutOfDate = true;
+		else if (acquireResult != VK_SUCCESS)
+			throw std::runtime_error("Failed to acquire an Image!");
+	}
+
+	// With more images than frames in flight the image can still be in use by a frame from another slot
+	{
+		PROFILE_SCOPE("Wait for image");
+		WaitForFrameTimeline(s_Context->ImagesInFlight[nextImageIndex]);
+	}
+
+	// Instance data isn't part of the recording, it's read from the instance buffer when the frame executes.
+	// When GPU driven the draws aren't either, they are built by the cull pass
+	const bool drawsChanged = frame.BuffersRecreated
+		|| memcmp(&frame.RecordedViewProjection, &s_ViewProjection, sizeof(glm::mat4)) != 0
+		|| (!s_Context->GpuDriven && (frame.RecordedMeshGeneration != s_MeshGeneration || frame.RecordedPipelineGeneration != s_PipelineGeneration
+			|| frame.RecordedDrawList != s_DrawList));
+
+	s_LastRecordTimeMs = 0.0f;
+
+	if (drawsChanged || frame.RecordedImageIndex != nextImageIndex)
+	{
+		// Compiling on this thread would have stalled the frame, count the first draw of every material that didn't wait
+		if (s_CompilingMaterialCount > 0)
+		{
+			for (const auto& draw : s_DrawList)
+			{
+				if (s_MaterialPipelines[draw.Material] != nullptr || s_MaterialFallbackCounted[draw.Material])
+					continue;
+
+				s_MaterialFallbackCounted[draw.Material] = true;
+				s_HitchesAvoided++;
+			}
+		}
+
+		const auto recordStart = std::chrono::steady_clock::now();
+		RecordCommands(s_CurrentFrame, nextImageIndex, drawsChanged);
+		s_LastRecordTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+	}
+
+	// Uploads queued since the last frame go first, they are made visible to the graphics queue before the draws that read them
+	VulkanUploader::Flush();
+
+	const uint64_t uploadedBytes = VulkanUploader::GetUploadedBytes();
+	s_FrameCounters.UploadedBytes += uploadedBytes - s_LastUploadedBytes;
+	s_LastUploadedBytes = uploadedBytes;
+
+	const VkSemaphore renderFinishedSemaphore = s_Context->Headless ? nullptr : s_Context->RenderFinishedSemaphores[nextImageIndex];
+	const uint64_t timelineValue = s_FrameNumber + 1;
+
+	// The binary semaphore's value is ignored
+	const VkSemaphore signalSemaphores[] = { s_Context->FrameTimeline, renderFinishedSemaphore };
+	const uint64_t signalValues[] = { timelineValue, 0 };
+	constexpr uint64_t waitValue = 0;
 
 	constexpr VkPipelineStageFlags waitStages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
 
-	submitInfo.pWaitDstStageMask = waitStages;
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &s_Context->CommandBuffers[nextImageIndex];
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+	submitInfo.pCommandBuffers = &frame.CommandBuffer;
+	submitInfo.signalSemaphoreCount = s_Context->Headless ? 1 : 2;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	if (!s_Context->Headless)
+	{
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+		submitInfo.pWaitDstStageMask = waitStages;
+	}
+
+	timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+	timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+	timelineSubmitInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+	{
+		PROFILE_SCOPE("Submit");
+		if (vkQueueSubmit(s_Context->GraphicsQueue, 1, &submitInfo, nullptr) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+	}
+
+	VulkanGpuProfiler::MarkSubmitted(s_CurrentFrame);
+	s_FrameCounters.Commands = frame.RecordedCounters;
+	s_FrameCounters.RecordMs = s_LastRecordTimeMs;
+	s_FrameCounters.ClustersTested = s_ClustersTested;
+	s_FrameCounters.ClustersCulled = s_ClustersCulled;
+	frame.TimelineValue = timelineValue;
+	s_Context->ImagesInFlight[nextImageIndex] = timelineValue;
+
+	if (!s_Context->Headless)
+	{
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &s_Context->SwapChain;
+		presentInfo.pImageIndices = &nextImageIndex;
+
+		VkPresentIdKHR presentId = {};
+		presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentId.swapchainCount = 1;
+		presentId.pPresentIds = &timelineValue;
+
+		if (s_Context->WaitForPresent != nullptr)
+			presentInfo.pNext = &presentId;
+
+		PROFILE_SCOPE("Present");
+		const VkResult presentResult = vkQueuePresentKHR(s_Context->GraphicsQueue, &presentInfo);
+
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+			s_Context->SwapChainOutOfDate = true;
+		else if (presentResult != VK_SUCCESS)
+			throw std::runtime_error("Failed to present Image!");
+	}
+
+	s_DrawList.clear();
+	s_Instances.clear();
+	s_ObjectMeshes.clear();
+	s_ClustersTested = 0;
+	s_ClustersCulled = 0;
+	s_Context->LastDrawnImage = nextImageIndex;
+	s_CurrentFrame = (s_CurrentFrame + 1) % s_Context->FramesInFlight;
+	s_FrameNumber++;
+	s_LastFrameCounters = s_FrameCounters;
+
+	s_Context->Pacer->EndFrame();
+	s_Context->FrameStarted = false;
+}
+
+VulkanRenderer::MeshHandle VulkanRenderer::CreateMesh(const Utils::VertexData* vertices, uint32_t verticesCount, const uint32_t* indices, uint32_t indicesCount)
+{
+	return CreateMeshes({ { vertices, verticesCount, indices, indicesCount } })[0];
+}
+
+std::vector<VulkanRenderer::MeshHandle> VulkanRenderer::CreateMeshes(const std::vector<MeshDescription>& meshes)
+{
+	PROFILE_FUNCTION();
+
+	// The meshes are uploaded from these, they only have to outlive the VulkanMesh constructors
+	struct ProcessedMesh
+	{
+		std::vector<Utils::VertexData> Vertices;
+		std::vector<uint32_t> Indices;
+		std::vector<MeshLod> Lods;
+		std::vector<Meshlet> Meshlets;
+		MeshOptimizationStats Optimization{};
+	};
+
+	const bool processMeshes = s_Context->OptimizeMeshes || s_Context->GenerateLods || s_Context->BuildMeshlets;
+	std::vector<ProcessedMesh> processed(processMeshes ? meshes.size() : 0);
+
+	const auto processMesh = [&](uint32_t meshIndex)
+	{
+		const MeshDescription& description = meshes[meshIndex];
+		ProcessedMesh& mesh = processed[meshIndex];
+		mesh.Vertices.assign(description.Vertices, description.Vertices + description.VerticesCount);
+		mesh.Indices.assign(description.Indices, description.Indices + description.IndicesCount);
+
+		if (s_Context->OptimizeMeshes)
+			mesh.Optimization = MeshOptimizer::Optimize(mesh.Vertices, mesh.Indices, s_Context->OptimizerSettings);
+
+		if (s_Context->GenerateLods)
+			mesh.Lods = MeshSimplifier::GenerateLods(mesh.Vertices, mesh.Indices, s_Context->LodSettings);
+
+		// The simplified levels are reordered for the vertex cache too, the vertices stay in the order the full level fetches them
+		if (s_Context->OptimizeMeshes && s_Context->OptimizerSettings.OptimizeVertexCache)
+		{
+			for (size_t lod = 1; lod < mesh.Lods.size(); lod++)
+			{
+				const auto first = mesh.Indices.begin() + mesh.Lods[lod].FirstIndex;
+				std::vector<uint32_t> lodIndices(first, first + mesh.Lods[lod].IndexCount);
+				MeshOptimizer::OptimizeVertexCache(lodIndices, (uint32_t)mesh.Vertices.size());
+				std::copy(lodIndices.begin(), lodIndices.end(), first);
+			}
+		}
+
+		if (!s_Context->BuildMeshlets)
+			return;
+
+		// Only the full level is split, the coarser ones are drawn whole. Meshlets are seeded in the order the triangles come in,
+		// so the overdraw order mostly survives, but the cache and fetch orders are redone within the meshlets
+		const uint32_t fullIndexCount = mesh.Lods.empty() ? (uint32_t)mesh.Indices.size() : mesh.Lods[0].IndexCount;
+		mesh.Meshlets = MeshletBuilder::Build(mesh.Vertices, mesh.Indices, 0, fullIndexCount);
+
+		if (!s_Context->OptimizeMeshes)
+			return;
+
+		if (s_Context->OptimizerSettings.OptimizeVertexCache)
+		{
+			for (const Meshlet& meshlet : mesh.Meshlets)
+			{
+				const auto first = mesh.Indices.begin() + meshlet.FirstIndex;
+				std::vector<uint32_t> meshletIndices(first, first + meshlet.IndexCount);
+				MeshOptimizer::OptimizeVertexCache(meshletIndices, (uint32_t)mesh.Vertices.size());
+				std::copy(meshletIndices.begin(), meshletIndices.end(), first);
+			}
+		}
+
+		// Renumbering keeps every index where it is, the meshlet ranges and bounds stay valid
+		if (s_Context->OptimizerSettings.OptimizeVertexFetch)
+			MeshOptimizer::OptimizeVertexFetch(mesh.Vertices, mesh.Indices);
+
+		// The stats describe the full level as it's uploaded
+		const std::vector<uint32_t> fullIndices(mesh.Indices.begin(), mesh.Indices.begin() + fullIndexCount);
+		mesh.Optimization.VertexCountAfter = mesh.Vertices.size();
+		mesh.Optimization.TransformsAfter = MeshOptimizer::CountTransforms(fullIndices, (uint32_t)mesh.Vertices.size());
+	};
+
+	if (processMeshes && s_Context->RecordingThreadPool != nullptr && meshes.size() > 1)
+		s_Context->RecordingThreadPool->ParallelFor((uint32_t)meshes.size(), processMesh);
+	else if (processMeshes)
+	{
+		for (uint32_t i = 0; i < (uint32_t)meshes.size(); i++)
+			processMesh(i);
+	}
+
+	std::vector<MeshHandle> handles;
+	handles.reserve(meshes.size());
 
-	if (vkQueueSubmit(s_Context->GraphicsQueue, 1, &submitInfo, drawFence) != VK_SUCCESS)
-		throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		VulkanMesh::MeshCreateInfo meshCreateInfo = {
+			meshCreateInfo.GeometryPool = &s_Context->GeometryPool,
+			meshCreateInfo.Vertices = meshes[i].Vertices,
+			meshCreateInfo.VerticesCount = meshes[i].VerticesCount,
+			meshCreateInfo.Indices = meshes[i].Indices,
+			meshCreateInfo.IndicesCount = meshes[i].IndicesCount,
+			meshCreateInfo.Lods = nullptr,
+			meshCreateInfo.LodCount = 0,
+			meshCreateInfo.Meshlets = nullptr,
+			meshCreateInfo.MeshletCount = 0
+		};
+
+		if (processMeshes)
+		{
+			const ProcessedMesh& mesh = processed[i];
+			meshCreateInfo.Vertices = mesh.Vertices.data();
+			meshCreateInfo.VerticesCount = (uint32_t)mesh.Vertices.size();
+			meshCreateInfo.Indices = mesh.Indices.data();
+			meshCreateInfo.IndicesCount = (uint32_t)mesh.Indices.size();
+			meshCreateInfo.Lods = mesh.Lods.data();
+			meshCreateInfo.LodCount = (uint32_t)mesh.Lods.size();
+			meshCreateInfo.Meshlets = mesh.Meshlets.data();
+			meshCreateInfo.MeshletCount = (uint32_t)mesh.Meshlets.size();
+			s_Context->MeshOptimization.Add(mesh.Optimization);
+		}
+
+		if (!s_FreeMeshHandles.empty())
+		{
+			const MeshHandle handle = s_FreeMeshHandles.back();
+			s_FreeMeshHandles.pop_back();
+			s_Meshes[handle] = VulkanMesh(meshCreateInfo);
+			handles.push_back(handle);
+		}
+		else
+		{
+			s_Meshes.emplace_back(VulkanMesh(meshCreateInfo));
+			handles.push_back((MeshHandle)(s_Meshes.size() - 1));
+		}
+	}
+
+	s_MeshGeneration++;
+	return handles;
+}
+
+void VulkanRenderer::DestroyMesh(MeshHandle mesh)
+{
+	if (mesh >= s_Meshes.size() || !s_Meshes[mesh].IsValid())
+		throw std::runtime_error("Trying to destroy an invalid mesh!");
+
+	s_RetiredMeshes.emplace_back(s_FrameNumber, s_Meshes[mesh]);
+	s_Meshes[mesh] = VulkanMesh();
+	s_FreeMeshHandles.push_back(mesh);
+	s_MeshGeneration++;
+}
+
+bool VulkanRenderer::IsMeshReady(MeshHandle mesh)
+{
+	if (mesh >= s_Meshes.size() || !s_Meshes[mesh].IsValid())
+		throw std::runtime_error("Trying to query an invalid mesh!");
+
+	return s_Meshes[mesh].IsUploaded();
+}
+
+VulkanRenderer::MaterialHandle VulkanRenderer::CreateMaterial(const MaterialDescription& material)
+{
+	if (material.Wireframe && !s_Context->WireframeSupported)
+		throw std::runtime_error("Wireframe materials require the fillModeNonSolid feature!");
 
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &s_Context->SwapChain;
-	presentInfo.pImageIndices = &nextImageIndex;
+	GraphicsPipelineDescription description = s_Materials[DEFAULT_MATERIAL];
+	description.PolygonMode = material.Wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+	description.CullMode = material.DoubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+	description.BlendEnable = material.Blend;
 
-	if (vkQueuePresentKHR(s_Context->GraphicsQueue, &presentInfo) != VK_SUCCESS)
-		throw std::runtime_error("Failed to present Image!");
+	VkPipeline pipeline = VulkanPipelineCache::RequestGraphicsPipeline(description);
 
-	s_CurrentFrame = (s_CurrentFrame + 1) % Utils::MAX_FRAME_DRAWS;
+	// An identical description already failed in the background, it would never be committed again
+	if (pipeline == nullptr && VulkanPipelineCache::HasGraphicsPipelineFailed(description))
+	{
+		std::cerr << "Material " << s_Materials.size() << " failed to compile, it's drawn with the default material\n";
+		pipeline = s_Context->GraphicsPipeline;
+	}
+
+	if (pipeline == nullptr)
+		s_CompilingMaterialCount++;
+
+	s_Materials.push_back(description);
+	s_MaterialPipelines.push_back(pipeline);
+	s_MaterialFallbackCounted.push_back(false);
+	return (MaterialHandle)(s_Materials.size() - 1);
+}
+
+bool VulkanRenderer::IsMaterialReady(MaterialHandle material)
+{
+	if (material >= s_Materials.size())
+		throw std::runtime_error("Trying to query an invalid material!");
+
+	return s_MaterialPipelines[material] != nullptr;
+}
+
+void VulkanRenderer::Submit(MeshHandle mesh, MaterialHandle material)
+{
+	static const Utils::InstanceData identityInstance = { glm::mat4(1.0f), glm::vec4(1.0f) };
+	SubmitInstanced(mesh, &identityInstance, 1, material);
+}
+
+void VulkanRenderer::SubmitInstanced(MeshHandle mesh, const Utils::InstanceData* instances, uint32_t instanceCount, MaterialHandle material)
+{
+	if (mesh >= s_Meshes.size() || !s_Meshes[mesh].IsValid())
+		throw std::runtime_error("Trying to submit an invalid mesh!");
+
+	if (material >= s_Materials.size())
+		throw std::runtime_error("Trying to submit with an invalid material!");
+
+	if (instanceCount == 0)
+		return;
+
+	// The cull pass builds the draws per instance, only which mesh each one uses is needed. It culls whole instances, never meshlets
+	if (s_Context->GpuDriven)
+	{
+		s_Instances.insert(s_Instances.end(), instances, instances + instanceCount);
+		s_ObjectMeshes.insert(s_ObjectMeshes.end(), instanceCount, mesh);
+		return;
+	}
+
+	const VulkanMesh& vulkanMesh = s_Meshes[mesh];
+	// A single meshlet is already tested as the whole object
+	const bool cullClusters = vulkanMesh.GetClusters().GetCount() > 1;
+
+	if (vulkanMesh.GetLodCount() == 1 && !cullClusters)
+	{
+		AppendDraw(mesh, material, vulkanMesh.GetFirstIndex(), vulkanMesh.GetIndicesCount(), instances, instanceCount);
+		return;
+	}
+
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 camera(0.0f);
+	bool cullBackfaces = false;
+
+	if (cullClusters)
+	{
+		const GraphicsPipelineDescription& description = s_Materials[material];
+		ExtractFrustumPlanes(s_ViewProjection, frustumPlanes);
+		camera = Utils::GetHomogeneousCamera(s_ViewProjection) * (description.FrontFace == VK_FRONT_FACE_COUNTER_CLOCKWISE ? -1.0f : 1.0f);
+		cullBackfaces = description.CullMode == VK_CULL_MODE_BACK_BIT;
+	}
+
+	// Runs of instances with the same level share a draw, they are kept in the order they were submitted.
+	// Instances at full detail with meshlets are culled and drawn on their own
+	const float lodScale = GetLodScale(s_ViewProjection);
+	uint32_t runStart = 0;
+	uint32_t runLod = 0;
+
+	const auto appendRun = [&](uint32_t runEnd)
+	{
+		if (runEnd > runStart)
+			AppendDraw(mesh, material, vulkanMesh.GetFirstIndex(runLod), vulkanMesh.GetIndicesCount(runLod), instances + runStart, runEnd - runStart);
+	};
+
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		const uint32_t lod = vulkanMesh.GetLodCount() > 1 ? SelectLod(vulkanMesh, instances[i].Transform, lodScale) : 0;
+
+		if (cullClusters && lod == 0)
+		{
+			appendRun(i);
+			AppendClusterDraws(mesh, material, instances[i], frustumPlanes, camera, cullBackfaces);
+			runStart = i + 1;
+			continue;
+		}
+
+		if (lod != runLod)
+		{
+			appendRun(i);
+			runStart = i;
+			runLod = lod;
+		}
+	}
+
+	appendRun(instanceCount);
+}
+
+void VulkanRenderer::SetCamera(const glm::mat4& viewProjection)
+{
+	s_ViewProjection = viewProjection;
+}
+
+float VulkanRenderer::GetLastRecordTimeMs()
+{
+	return s_LastRecordTimeMs;
+}
+
+uint32_t VulkanRenderer::GetRecordingThreadCount()
+{
+	return s_Context->RecordingThreadPool != nullptr ? s_Context->RecordingThreadPool->GetThreadCount() : 1;
+}
+
+uint32_t VulkanRenderer::GetFramesInFlight()
+{
+	return s_Context->FramesInFlight;
+}
+
+VkPresentModeKHR VulkanRenderer::GetPresentMode()
+{
+	return s_Context->PresentMode;
+}
+
+FrameLatencyStats VulkanRenderer::GetLatencyStats()
+{
+	CompletePacedFrames();
+	return s_Context->Pacer->GetStats();
+}
+
+PipelineCompileStats VulkanRenderer::GetPipelineCompileStats()
+{
+	PipelineCompileStats stats = VulkanPipelineCache::GetCompileStats();
+	stats.HitchesAvoided = s_HitchesAvoided;
+	return stats;
+}
+
+std::vector<GpuZoneStats> VulkanRenderer::GetGpuZoneStats()
+{
+	return VulkanGpuProfiler::GetZoneStats();
+}
+
+RendererStats VulkanRenderer::GetStats()
+{
+	RendererStats stats;
+	stats.FrameNumber = s_FrameNumber;
+	stats.LastFrame = s_LastFrameCounters;
+	stats.PipelineStatisticsAvailable = VulkanGpuProfiler::GetPipelineStatistics(stats.LastPipelineStatistics);
+	stats.GpuZones = VulkanGpuProfiler::GetZoneStats();
+	stats.Latency = GetLatencyStats();
+	stats.PipelineCompile = GetPipelineCompileStats();
+	stats.PipelineCacheHits = VulkanPipelineCache::GetHitCount();
+	stats.PipelineCacheMisses = VulkanPipelineCache::GetMissCount();
+	stats.GraphicsPipelineCount = VulkanPipelineCache::GetGraphicsPipelineCount();
+	stats.UploadSubmitCount = VulkanUploader::GetSubmitCount();
+	stats.Heaps = VulkanAllocator::GetHeapStats();
+	stats.MeshOptimization = s_Context->MeshOptimization;
+	return stats;
+}
+
+bool VulkanRenderer::IsHeadless()
+{
+	return s_Context != nullptr && s_Context->Headless;
+}
+
+std::string VulkanRenderer::GetDeviceName()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(s_Context->PhysicalDevice, &properties);
+	return properties.deviceName;
+}
+
+bool VulkanRenderer::IsGpuDriven()
+{
+	return s_Context != nullptr && s_Context->GpuDriven;
+}
+
+void VulkanRenderer::ReadFrame(std::vector<uint8_t>& outPixels, uint32_t& outWidth, uint32_t& outHeight)
+{
+	PROFILE_FUNCTION();
+
+	if (!s_Context->Headless)
+		throw std::runtime_error("Reading back frames is only supported in headless mode!");
+
+	if (s_Context->LastDrawnImage == UINT32_MAX)
+		throw std::runtime_error("No frame has been drawn yet!");
+
+	const VkExtent2D extent = s_Context->SwapChainExtent;
+	const VkDeviceSize frameSize = (VkDeviceSize)extent.width * extent.height * 4;
+
+	Utils::WaitForTimeline(s_Context->LogicalDevice, s_Context->FrameTimeline, s_Context->ImagesInFlight[s_Context->LastDrawnImage]);
+
+	VkCommandBuffer readbackCommandBuffer;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = s_Context->GraphicsCommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(s_Context->LogicalDevice, &allocInfo, &readbackCommandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate a Command Buffer!");
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(readbackCommandBuffer, &beginInfo);
+
+	// The render pass leaves the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	VkBufferImageCopy copyRegion = {};
+	copyRegion.bufferOffset = 0;
+	copyRegion.bufferRowLength = 0;
+	copyRegion.bufferImageHeight = 0;
+	copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copyRegion.imageSubresource.mipLevel = 0;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount = 1;
+	copyRegion.imageOffset = { 0, 0, 0 };
+	copyRegion.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(readbackCommandBuffer, s_Context->SwapChainImages[s_Context->LastDrawnImage].Image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, s_Context->ReadbackBuffer, 1, &copyRegion);
+
+	// Make the transfer write visible to the host before mapping
+	VkMemoryBarrier hostBarrier = {};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(readbackCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+	vkEndCommandBuffer(readbackCommandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &readbackCommandBuffer;
+
+	vkQueueSubmit(s_Context->GraphicsQueue, 1, &submitInfo, nullptr);
+	vkQueueWaitIdle(s_Context->GraphicsQueue);
+
+	vkFreeCommandBuffers(s_Context->LogicalDevice, s_Context->GraphicsCommandPool, 1, &readbackCommandBuffer);
+
+	outPixels.resize(frameSize);
+
+	memcpy(outPixels.data(), s_Context->ReadbackBufferAllocation.MappedData, frameSize);
+
+	outWidth = extent.width;
+	outHeight = extent.height;
 }
 
 void VulkanRenderer::Shutdown()
 {
+	PROFILE_FUNCTION();
+
 	vkDeviceWaitIdle(s_Context->LogicalDevice);
 
 	for (auto& mesh : s_Meshes)
 		mesh.Destroy();
 
-	for (uint32_t i = 0; i < Utils::MAX_FRAME_DRAWS; i++)
+	for (auto& [retiredFrame, mesh] : s_RetiredMeshes)
+		mesh.Destroy();
+
+	for (auto& retired : s_Context->RetiredSwapChains)
+		DestroyRetiredSwapChain(retired);
+
+	for (auto& semaphore : s_Context->RenderFinishedSemaphores)
+		vkDestroySemaphore(s_Context->LogicalDevice, semaphore, nullptr);
+
+	for (auto& semaphore : s_Context->ImageAvailableSemaphores)
+		vkDestroySemaphore(s_Context->LogicalDevice, semaphore, nullptr);
+
+	vkDestroySemaphore(s_Context->LogicalDevice, s_Context->FrameTimeline, nullptr);
+
+	for (auto& frame : s_Context->Frames)
 	{
-		vkDestroySemaphore(s_Context->LogicalDevice, s_Context->RenderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(s_Context->LogicalDevice, s_Context->ImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(s_Context->LogicalDevice, s_Context->DrawFences[i], nullptr);
+		DestroyBuffer(frame.InstanceBuffer, frame.InstanceBufferAllocation);
+		DestroyBuffer(frame.ObjectMeshBuffer, frame.ObjectMeshBufferAllocation);
+		DestroyBuffer(frame.MeshDataBuffer, frame.MeshDataBufferAllocation);
+		DestroyBuffer(frame.CullDataBuffer, frame.CullDataBufferAllocation);
+		DestroyBuffer(frame.DrawCommandBuffer, frame.DrawCommandBufferAllocation);
+		DestroyBuffer(frame.DrawCountBuffer, frame.DrawCountBufferAllocation);
+
+		for (auto& secondaryCommandPool : frame.SecondaryCommandPools)
+			vkDestroyCommandPool(s_Context->LogicalDevice, secondaryCommandPool, nullptr);
+
+		vkDestroyCommandPool(s_Context->LogicalDevice, frame.CommandPool, nullptr);
 	}
 
 	vkDestroyCommandPool(s_Context->LogicalDevice, s_Context->GraphicsCommandPool, nullptr);
@@ -204,28 +1316,76 @@ void VulkanRenderer::Shutdown()
 	for (auto& framebuffer : s_Context->SwapChainFramebuffers)
 		vkDestroyFramebuffer(s_Context->LogicalDevice, framebuffer, nullptr);
 
-	vkDestroyPipeline(s_Context->LogicalDevice, s_Context->GraphicsPipeline, nullptr);
+	vkDestroyPipeline(s_Context->LogicalDevice, s_Context->CullingPipeline, nullptr);
+	vkDestroyPipelineLayout(s_Context->LogicalDevice, s_Context->CullingPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(s_Context->LogicalDevice, s_Context->CullingDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(s_Context->LogicalDevice, s_Context->CullingDescriptorSetLayout, nullptr);
+
+	// The graphics pipeline belongs to the pipeline cache
 	vkDestroyPipelineLayout(s_Context->LogicalDevice, s_Context->PipelineLayout, nullptr);
 	vkDestroyRenderPass(s_Context->LogicalDevice, s_Context->RenderPass, nullptr);
 
-	for (auto& image : s_Context->SwapChainImages)
-		vkDestroyImageView(s_Context->LogicalDevice, image.ImageView, nullptr);
+	for (auto& image : s_Context->SwapChainImages)
+		vkDestroyImageView(s_Context->LogicalDevice, image.ImageView, nullptr);
+
+	if (s_Context->Headless)
+	{
+		for (size_t i = 0; i < s_Context->SwapChainImages.size(); i++)
+		{
+			vkDestroyImage(s_Context->LogicalDevice, s_Context->SwapChainImages[i].Image, nullptr);
+			VulkanAllocator::Free(s_Context->OffscreenImagesAllocations[i]);
+		}
+
+		vkDestroyBuffer(s_Context->LogicalDevice, s_Context->ReadbackBuffer, nullptr);
+		VulkanAllocator::Free(s_Context->ReadbackBufferAllocation);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(s_Context->LogicalDevice, s_Context->SwapChain, nullptr);
+		vkDestroySurfaceKHR(s_Context->VulkanInstance, s_Context->Surface, nullptr);
+	}
 
-	vkDestroySwapchainKHR(s_Context->LogicalDevice, s_Context->SwapChain, nullptr);
-	vkDestroySurfaceKHR(s_Context->VulkanInstance, s_Context->Surface, nullptr);
+	s_Context->GeometryPool.Destroy();
+	VulkanGpuProfiler::Shutdown();
+	VulkanPipelineCache::Shutdown();
+	VulkanUploader::Shutdown();
+	VulkanAllocator::Shutdown();
 	vkDestroyDevice(s_Context->LogicalDevice, nullptr);
 	DestroyDebugCallback();
 	vkDestroyInstance(s_Context->VulkanInstance, nullptr);
 
 	delete s_Context;
+	s_Context = nullptr;
+	s_CurrentFrame = 0;
+	s_FrameNumber = 0;
+	s_Meshes.clear();
+	s_FreeMeshHandles.clear();
+	s_RetiredMeshes.clear();
+	s_DrawList.clear();
+	s_Instances.clear();
+	s_ObjectMeshes.clear();
+	s_ClustersTested = 0;
+	s_ClustersCulled = 0;
+	s_ViewProjection = glm::mat4(1.0f);
+	s_Materials.clear();
+	s_MaterialPipelines.clear();
+	s_MaterialFallbackCounted.clear();
+	s_CompilingMaterialCount = 0;
+	s_PipelineGeneration = 0;
+	s_HitchesAvoided = 0;
 }
 
 std::vector<const char*> VulkanRenderer::ValidateExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// Headless mode never touches GLFW so it can run on machines without a display
+	if (!s_Context->Headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 #if defined(VULKAN_DEBUG)
 	if (!Debug::CheckValidationLayerSupport())
@@ -234,7 +1394,7 @@ std::vector<const char*> VulkanRenderer::ValidateExtensions()
 	extensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
 
-	if (!Utils::CheckInstanceExtensionSupport(extensions))
+	if (!extensions.empty() && !Utils::CheckInstanceExtensionSupport(extensions))
 		throw std::runtime_error("VkInstance does not support required extensions!");
 
 	return extensions;
@@ -242,6 +1402,8 @@ std::vector<const char*> VulkanRenderer::ValidateExtensions()
 
 void VulkanRenderer::CreateInstance(const std::vector<const char*>& extensions)
 {
+	PROFILE_FUNCTION();
+
 	VkApplicationInfo appInfo;
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	appInfo.pNext = nullptr;
@@ -270,6 +1432,8 @@ void VulkanRenderer::CreateInstance(const std::vector<const char*>& extensions)
 
 void VulkanRenderer::CreateSurface()
 {
+	PROFILE_FUNCTION();
+
 	const auto result = glfwCreateWindowSurface(s_Context->VulkanInstance,
 		s_Context->Window->GetGLFWWindow(),
 		nullptr, &s_Context->Surface);
@@ -281,6 +1445,8 @@ void VulkanRenderer::CreateSurface()
 
 void VulkanRenderer::GetPhysicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(s_Context->VulkanInstance, &deviceCount, nullptr);
 
@@ -302,14 +1468,20 @@ void VulkanRenderer::GetPhysicalDevice()
 			break;
 		}
 	}
+
+	if (s_Context->PhysicalDevice == nullptr)
+		throw std::runtime_error("Couldn't find a suitable GPU!");
 }
 
 void VulkanRenderer::CreateLogicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::unordered_set<int32_t> queueFamilyIndices {
 		s_Context->DeviceQueueFamilyIndices.GraphicsFamily,
-		s_Context->DeviceQueueFamilyIndices.PresentationFamily
+		s_Context->DeviceQueueFamilyIndices.PresentationFamily,
+		s_Context->DeviceQueueFamilyIndices.TransferFamily
 	};
 
 	for (int32_t queueFamilyIndex : queueFamilyIndices)
@@ -324,14 +1496,91 @@ void VulkanRenderer::CreateLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedDeviceFeatures = {};
+	vkGetPhysicalDeviceFeatures(s_Context->PhysicalDevice, &supportedDeviceFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 
+	// Optional, only wireframe materials need it
+	s_Context->WireframeSupported = supportedDeviceFeatures.fillModeNonSolid;
+	deviceFeatures.fillModeNonSolid = supportedDeviceFeatures.fillModeNonSolid;
+
+	// Optional, only the pipeline statistics in RendererStats need them
+	s_Context->PipelineStatisticsSupported = supportedDeviceFeatures.pipelineStatisticsQuery && supportedDeviceFeatures.inheritedQueries;
+	deviceFeatures.pipelineStatisticsQuery = s_Context->PipelineStatisticsSupported;
+	deviceFeatures.inheritedQueries = s_Context->PipelineStatisticsSupported;
+
+	// Checked by CheckDeviceIsSuitable
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
+	if (s_Context->GpuDriven)
+	{
+		VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+		supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+		VkPhysicalDeviceFeatures2 supportedFeatures = {};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supportedVulkan12Features;
+
+		vkGetPhysicalDeviceFeatures2(s_Context->PhysicalDevice, &supportedFeatures);
+
+		// Without multiDrawIndirect maxDrawIndirectCount is 1
+		if (!supportedFeatures.features.multiDrawIndirect || !supportedVulkan12Features.drawIndirectCount)
+			throw std::runtime_error("GPU driven rendering requires the multiDrawIndirect and drawIndirectCount features!");
+
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		vulkan12Features.drawIndirectCount = VK_TRUE;
+	}
+
 	VkDeviceCreateInfo deviceCreateInfo = {};
+	deviceCreateInfo.pNext = &vulkan12Features;
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-	deviceCreateInfo.enabledExtensionCount = (uint32_t)Utils::s_DeviceExtensions.size();
-	deviceCreateInfo.ppEnabledExtensionNames = Utils::s_DeviceExtensions.data();
+
+	std::vector<const char*> deviceExtensions;
+	if (!s_Context->Headless)
+		deviceExtensions = Utils::s_DeviceExtensions;
+
+	// Optional, presentation is waited on to measure latency up to the frame being displayed
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.pNext = &presentWaitFeatures;
+
+	bool presentWait = !s_Context->Headless
+		&& Utils::CheckDeviceExtensionSupport(s_Context->PhysicalDevice, { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME });
+
+	if (presentWait)
+	{
+		VkPhysicalDeviceFeatures2 supportedFeatures = {};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &presentIdFeatures;
+
+		vkGetPhysicalDeviceFeatures2(s_Context->PhysicalDevice, &supportedFeatures);
+		presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+	}
+
+	if (presentWait)
+	{
+		// The queried structs are chained as they are, both features are already set
+		presentWaitFeatures.pNext = vulkan12Features.pNext;
+		vulkan12Features.pNext = &presentIdFeatures;
+		deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+
+	// Optional, only used to report whether pipelines were found in the pipeline cache
+	s_Context->PipelineCreationFeedback = Utils::CheckDeviceExtensionSupport(s_Context->PhysicalDevice, { VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME });
+	if (s_Context->PipelineCreationFeedback)
+		deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+	deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
+	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
 	if (vkCreateDevice(s_Context->PhysicalDevice, &deviceCreateInfo, nullptr, &s_Context->LogicalDevice) != VK_SUCCESS)
@@ -339,12 +1588,20 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	vkGetDeviceQueue(s_Context->LogicalDevice, s_Context->DeviceQueueFamilyIndices.GraphicsFamily, 0, &s_Context->GraphicsQueue);
 	vkGetDeviceQueue(s_Context->LogicalDevice, s_Context->DeviceQueueFamilyIndices.PresentationFamily, 0, &s_Context->PresentationQueue);
+	vkGetDeviceQueue(s_Context->LogicalDevice, s_Context->DeviceQueueFamilyIndices.TransferFamily, 0, &s_Context->TransferQueue);
+
+	if (presentWait)
+		s_Context->WaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(s_Context->LogicalDevice, "vkWaitForPresentKHR");
+
+	s_Context->Pacer->SetMeasuredToPresent(s_Context->WaitForPresent != nullptr);
 }
 
 void VulkanRenderer::CreateSwapChain()
 {
+	PROFILE_FUNCTION();
+
 	VkSurfaceFormatKHR surfaceFormat = Utils::ChooseBestSurfaceFormat(s_Context->SwapChainDetails.Formats);
-	VkPresentModeKHR presentMode = Utils::ChooseBestPresentationMode(s_Context->SwapChainDetails.PresentationModes);
+	VkPresentModeKHR presentMode = Utils::ChooseBestPresentationMode(s_Context->SwapChainDetails.PresentationModes, s_Context->PresentMode);
 	VkExtent2D extent = Utils::ChooseSwapExtent(s_Context->SwapChainDetails.SurfaceCapabilities, s_Context->Window);
 
 	// Get 1 more image than the minimum to allow triple buffering
@@ -362,6 +1619,7 @@ void VulkanRenderer::CreateSwapChain()
 	createInfo.imageFormat = surfaceFormat.format;
 	createInfo.imageColorSpace = surfaceFormat.colorSpace;
 	createInfo.presentMode = presentMode;
+	s_Context->PresentMode = presentMode;
 	createInfo.imageExtent = extent;
 	createInfo.minImageCount = imageCount;
 	createInfo.imageArrayLayers = 1;
@@ -389,7 +1647,8 @@ void VulkanRenderer::CreateSwapChain()
 		createInfo.pQueueFamilyIndices = nullptr;
 	}
 
-	createInfo.oldSwapchain = nullptr;
+	// Null the first time, otherwise the swapchain being replaced so the driver can hand its resources over
+	createInfo.oldSwapchain = s_Context->SwapChain;
 
 	if (vkCreateSwapchainKHR(s_Context->LogicalDevice, &createInfo, nullptr, &s_Context->SwapChain) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create a Swapchain!");
@@ -399,8 +1658,97 @@ void VulkanRenderer::CreateSwapChain()
 	s_Context->SwapChainImages = Utils::GetSwapChainImages(s_Context->LogicalDevice, s_Context->SwapChain, surfaceFormat.format);
 }
 
+bool VulkanRenderer::RecreateSwapChain()
+{
+	PROFILE_FUNCTION();
+
+	// Only the capabilities follow the window, the formats and present modes stay the same
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(s_Context->PhysicalDevice, s_Context->Surface, &s_Context->SwapChainDetails.SurfaceCapabilities);
+
+	const VkExtent2D extent = Utils::ChooseSwapExtent(s_Context->SwapChainDetails.SurfaceCapabilities, s_Context->Window);
+	if (extent.width == 0 || extent.height == 0)
+		return false;
+
+	s_Context->Window->ClearResized();
+	s_Context->SwapChainOutOfDate = false;
+
+	// Submitted frames still reference the old objects. They are also kept for another FramesInFlight frames
+	// because the GPU finishing a frame doesn't mean its present is done with the image and semaphore
+	RendererContext::RetiredSwapChain retired = {
+		s_FrameNumber + s_Context->FramesInFlight,
+		s_Context->SwapChain,
+		std::move(s_Context->SwapChainImages),
+		std::move(s_Context->SwapChainFramebuffers),
+		std::move(s_Context->RenderFinishedSemaphores)
+	};
+
+	CreateSwapChain();
+	s_Context->RetiredSwapChains.push_back(std::move(retired));
+
+	CreateFramebuffers();
+	s_Context->RenderFinishedSemaphores = CreateSemaphores(s_Context->SwapChainImages.size());
+	s_Context->ImagesInFlight.assign(s_Context->SwapChainImages.size(), 0);
+
+	// Recorded command buffers reference the old framebuffers and extent
+	for (auto& frame : s_Context->Frames)
+	{
+		frame.RecordedImageIndex = UINT32_MAX;
+		frame.SecondariesRecorded = false;
+	}
+
+	return true;
+}
+
+void VulkanRenderer::CreateOffscreenTargets()
+{
+	PROFILE_FUNCTION();
+
+	const VkExtent2D extent = s_Context->HeadlessExtent;
+
+	// One image per frame in flight, they take the place of the swapchain images
+	s_Context->SwapChainImages.resize(s_Context->FramesInFlight);
+	s_Context->OffscreenImagesAllocations.resize(s_Context->FramesInFlight);
+
+	for (uint32_t i = 0; i < s_Context->FramesInFlight; i++)
+	{
+		auto& image = s_Context->SwapChainImages[i];
+
+		Utils::CreateImageInfo imageInfo = {
+			imageInfo.LogicalDevice = s_Context->LogicalDevice,
+			imageInfo.Width = extent.width,
+			imageInfo.Height = extent.height,
+			imageInfo.Format = Utils::HEADLESS_IMAGE_FORMAT,
+			imageInfo.Tiling = VK_IMAGE_TILING_OPTIMAL,
+			imageInfo.ImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			imageInfo.ImageProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			imageInfo.Image = &image.Image,
+			imageInfo.ImageAllocation = &s_Context->OffscreenImagesAllocations[i]
+		};
+
+		Utils::CreateImage(imageInfo);
+		image.ImageView = Utils::CreateImageView(s_Context->LogicalDevice, image.Image, Utils::HEADLESS_IMAGE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	// Host visible buffer that frames get copied into by ReadFrame
+	Utils::CreateBufferInfo readbackBufferInfo = {
+		readbackBufferInfo.LogicalDevice = s_Context->LogicalDevice,
+		readbackBufferInfo.BufferSize = (VkDeviceSize)extent.width * extent.height * 4,
+		readbackBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		readbackBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		readbackBufferInfo.Buffer = &s_Context->ReadbackBuffer,
+		readbackBufferInfo.BufferAllocation = &s_Context->ReadbackBufferAllocation
+	};
+
+	Utils::CreateBuffer(readbackBufferInfo);
+
+	s_Context->SwapChainImageFormat = Utils::HEADLESS_IMAGE_FORMAT;
+	s_Context->SwapChainExtent = extent;
+}
+
 void VulkanRenderer::CreateRenderPass()
 {
+	PROFILE_FUNCTION();
+
 	VkAttachmentDescription colorAttachment = {};
 	colorAttachment.format = s_Context->SwapChainImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -413,6 +1761,10 @@ void VulkanRenderer::CreateRenderPass()
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;		// Starting layout before the render pass starts
 	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;	// Final layout after all the sub-passes are done
 
+	// Headless frames are never presented, they are left ready to be copied out by ReadFrame
+	if (s_Context->Headless)
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
 	VkAttachmentReference colorAttachmentReference;
 	colorAttachmentReference.attachment = 0;
 	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // Layout used during the sub-passes
@@ -448,6 +1800,12 @@ void VulkanRenderer::CreateRenderPass()
 
 	subpassDependencies[1].dependencyFlags = 0;
 
+	if (s_Context->Headless)
+	{
+		subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		subpassDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	}
+
 	VkRenderPassCreateInfo renderPassCreateInfo = {};
 	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPassCreateInfo.attachmentCount = 1;
@@ -463,150 +1821,133 @@ void VulkanRenderer::CreateRenderPass()
 
 void VulkanRenderer::CreateGraphicsPipeline()
 {
-	const auto shader = VulkanShader::CreateFromSpv("Shader", "shaders/cache/vert.spv", "shaders/cache/frag.spv");
+	PROFILE_FUNCTION();
+
+	const auto shader = VulkanShader::CreateFromStages("Shader", {
+		{ VulkanShader::ShaderType::Vertex, "shaders/Shader.vert" },
+		{ VulkanShader::ShaderType::Fragment, "shaders/Shader.frag" }
+	});
 
-	VkShaderModule vertexShaderModule;
-	Utils::CreateShaderModule(shader->GetShaderBinary(VulkanShader::ShaderType::Vertex), s_Context->LogicalDevice, vertexShaderModule);
+	// The camera's view projection matrix
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::mat4);
 
-	VkShaderModule fragShaderModule;
-	Utils::CreateShaderModule(shader->GetShaderBinary(VulkanShader::ShaderType::Fragment), s_Context->LogicalDevice, fragShaderModule);
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 0;
+	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexShaderCreateInfo.module = vertexShaderModule;
-	vertexShaderCreateInfo.pName = "main";
+	if (vkCreatePipelineLayout(s_Context->LogicalDevice, &pipelineLayoutCreateInfo, nullptr, &s_Context->PipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create Pipeline Layout!");
 
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentShaderCreateInfo.module = fragShaderModule;
-	fragmentShaderCreateInfo.pName = "main";
+	GraphicsPipelineDescription description;
+	description.Shader = shader.get();
+	description.Layout = s_Context->PipelineLayout;
+	description.RenderPass = s_Context->RenderPass;
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+	// Built right away, everything falls back to it while other materials compile
+	s_Context->GraphicsPipeline = VulkanPipelineCache::GetGraphicsPipeline(description);
 
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Utils::VertexData);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	s_Materials.push_back(description);
+	s_MaterialPipelines.push_back(s_Context->GraphicsPipeline);
+	s_MaterialFallbackCounted.push_back(false);
+}
 
-	VkVertexInputAttributeDescription attributeDescriptions[2];
+void VulkanRenderer::CreateCullingPipeline()
+{
+	PROFILE_FUNCTION();
 
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Utils::VertexData, Position);
+	const auto shader = VulkanShader::CreateFromStages("Cull", {
+		{ VulkanShader::ShaderType::Compute, "shaders/Cull.comp" }
+	});
 
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Utils::VertexData, Color);
+	VkShaderModule computeShaderModule;
+	Utils::CreateShaderModule(shader->GetShaderBinary(VulkanShader::ShaderType::Compute), s_Context->LogicalDevice, computeShaderModule);
 
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t)std::size(attributeDescriptions);
-	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions;
+	// Instances, object meshes, mesh table, draw commands, draw count and the cull data
+	VkDescriptorSetLayoutBinding layoutBindings[6];
+	for (uint32_t i = 0; i < (uint32_t)std::size(layoutBindings); i++)
+	{
+		layoutBindings[i] = {};
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorType = i == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
-	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.bindingCount = (uint32_t)std::size(layoutBindings);
+	setLayoutCreateInfo.pBindings = layoutBindings;
 
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)s_Context->SwapChainExtent.width;
-	viewport.height = (float)s_Context->SwapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+	if (vkCreateDescriptorSetLayout(s_Context->LogicalDevice, &setLayoutCreateInfo, nullptr, &s_Context->CullingDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
 
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = s_Context->SwapChainExtent;
+	const VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * s_Context->FramesInFlight },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, s_Context->FramesInFlight }
+	};
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = s_Context->FramesInFlight;
+	poolCreateInfo.poolSizeCount = (uint32_t)std::size(poolSizes);
+	poolCreateInfo.pPoolSizes = poolSizes;
 
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizerCreateInfo.lineWidth = 1.0f;
-	rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
-	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-	multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState blendAttachmentState = {};
-	blendAttachmentState.blendEnable = VK_TRUE;
-	blendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	// Blending equation: (srcColorBlendFactor * newColor) colorBlendOp (dstColorBlendFaction * oldColor)
-	blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-	// (VK_BLEND_FACTOR_SRC_ALPHA * newColor) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * oldColor)
-	// (newColorAlpha * newColor) + ((1- newColorAlpha) * oldColor)
-
-	blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-	// (1 * newAlpha) + (0 * oldAlpha) = newAlpha
-
-	VkPipelineColorBlendStateCreateInfo blendingCreateInfo = {};
-	blendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	blendingCreateInfo.logicOpEnable = VK_FALSE;
-	blendingCreateInfo.attachmentCount = 1;
-	blendingCreateInfo.pAttachments = &blendAttachmentState;
+	if (vkCreateDescriptorPool(s_Context->LogicalDevice, &poolCreateInfo, nullptr, &s_Context->CullingDescriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
 
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 0;
-	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &s_Context->CullingDescriptorSetLayout;
 
-	if (vkCreatePipelineLayout(s_Context->LogicalDevice, &pipelineLayoutCreateInfo, nullptr, &s_Context->PipelineLayout) != VK_SUCCESS)
+	if (vkCreatePipelineLayout(s_Context->LogicalDevice, &pipelineLayoutCreateInfo, nullptr, &s_Context->CullingPipelineLayout) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create Pipeline Layout!");
 
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;
-	pipelineCreateInfo.pStages = shaderStages;
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
-	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &blendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr;
-	pipelineCreateInfo.layout = s_Context->PipelineLayout;
-	pipelineCreateInfo.renderPass = s_Context->RenderPass;
-	pipelineCreateInfo.subpass = 0;
-
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = computeShaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = s_Context->CullingPipelineLayout;
 	pipelineCreateInfo.basePipelineHandle = nullptr;
 	pipelineCreateInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(s_Context->LogicalDevice, nullptr, 1, &pipelineCreateInfo, nullptr, &s_Context->GraphicsPipeline) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create a Graphics Pipeline");
+	s_Context->CullingPipeline = VulkanPipelineCache::CreateComputePipeline("Cull", pipelineCreateInfo);
+
+	vkDestroyShaderModule(s_Context->LogicalDevice, computeShaderModule, nullptr);
+
+	// The buffers that don't depend on the scene size are created up front, the rest grow with it
+	for (auto& frame : s_Context->Frames)
+	{
+		VkDescriptorSetAllocateInfo setAllocInfo = {};
+		setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setAllocInfo.descriptorPool = s_Context->CullingDescriptorPool;
+		setAllocInfo.descriptorSetCount = 1;
+		setAllocInfo.pSetLayouts = &s_Context->CullingDescriptorSetLayout;
+
+		if (vkAllocateDescriptorSets(s_Context->LogicalDevice, &setAllocInfo, &frame.CullingDescriptorSet) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate a Descriptor Set!");
 
-	vkDestroyShaderModule(s_Context->LogicalDevice, fragShaderModule, nullptr);
-	vkDestroyShaderModule(s_Context->LogicalDevice, vertexShaderModule, nullptr);
+		RecreateBuffer(frame.CullDataBuffer, frame.CullDataBufferAllocation, sizeof(CullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		// One count per index type
+		RecreateBuffer(frame.DrawCountBuffer, frame.DrawCountBufferAllocation, sizeof(uint32_t) * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
 }
 
 void VulkanRenderer::CreateFramebuffers()
 {
+	PROFILE_FUNCTION();
+
 	s_Context->SwapChainFramebuffers.resize(s_Context->SwapChainImages.size());
 
 	for (size_t i = 0; i < s_Context->SwapChainImages.size(); i++)
@@ -632,6 +1973,8 @@ void VulkanRenderer::CreateFramebuffers()
 
 void VulkanRenderer::CreateCommandPool()
 {
+	PROFILE_FUNCTION();
+
 	VkCommandPoolCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	createInfo.queueFamilyIndex = (uint32_t)s_Context->DeviceQueueFamilyIndices.GraphicsFamily;
@@ -640,22 +1983,68 @@ void VulkanRenderer::CreateCommandPool()
 		throw std::runtime_error("Failed to create a Command Pool!");
 }
 
-void VulkanRenderer::CreateCommandBuffers()
+void VulkanRenderer::CreateCommandBuffers(uint32_t recordingThreadCount)
 {
-	s_Context->CommandBuffers.resize(s_Context->SwapChainFramebuffers.size());
+	PROFILE_FUNCTION();
+
+	if (recordingThreadCount == 0)
+		recordingThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	if (recordingThreadCount > 1)
+		s_Context->RecordingThreadPool = CreateScope<ThreadPool>(recordingThreadCount);
 
-	VkCommandBufferAllocateInfo cbAllocInfo = {};
-	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cbAllocInfo.commandPool = s_Context->GraphicsCommandPool;
-	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cbAllocInfo.commandBufferCount = (uint32_t)s_Context->CommandBuffers.size();
+	VkCommandPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolCreateInfo.queueFamilyIndex = (uint32_t)s_Context->DeviceQueueFamilyIndices.GraphicsFamily;
 
-	if (vkAllocateCommandBuffers(s_Context->LogicalDevice, &cbAllocInfo, s_Context->CommandBuffers.data()) != VK_SUCCESS)
-		throw std::runtime_error("Failed to allocate Command Buffers!");
+	for (auto& frame : s_Context->Frames)
+	{
+		if (vkCreateCommandPool(s_Context->LogicalDevice, &poolCreateInfo, nullptr, &frame.CommandPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Command Pool!");
+
+		VkCommandBufferAllocateInfo cbAllocInfo = {};
+		cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cbAllocInfo.commandPool = frame.CommandPool;
+		cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cbAllocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(s_Context->LogicalDevice, &cbAllocInfo, &frame.CommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate Command Buffers!");
+
+		if (s_Context->RecordingThreadPool == nullptr)
+			continue;
+
+		frame.SecondaryCommandPools.resize(recordingThreadCount);
+		frame.SecondaryCommandBuffers.resize(recordingThreadCount);
+
+		for (uint32_t i = 0; i < recordingThreadCount; i++)
+		{
+			if (vkCreateCommandPool(s_Context->LogicalDevice, &poolCreateInfo, nullptr, &frame.SecondaryCommandPools[i]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create a Command Pool!");
+
+			cbAllocInfo.commandPool = frame.SecondaryCommandPools[i];
+			cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+			if (vkAllocateCommandBuffers(s_Context->LogicalDevice, &cbAllocInfo, &frame.SecondaryCommandBuffers[i]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate Command Buffers!");
+		}
+	}
 }
 
-void VulkanRenderer::RecordCommands()
+void VulkanRenderer::RecordCommands(uint32_t frameIndex, uint32_t imageIndex, bool drawsChanged)
 {
+	PROFILE_FUNCTION();
+
+	auto& frame = s_Context->Frames[frameIndex];
+
+	// Splitting small draw lists across threads costs more than it saves. Inline draws are recorded again with the primary
+	const bool recordInParallel = !s_Context->GpuDriven && s_Context->RecordingThreadPool != nullptr && s_DrawList.size() >= Utils::PARALLEL_RECORDING_MIN_DRAWS;
+	const bool reuseSecondaries = recordInParallel && !drawsChanged && frame.SecondariesRecorded;
+
+	// The frame's timeline value has been waited on so nothing allocated from its pool is in use anymore
+	vkResetCommandPool(s_Context->LogicalDevice, frame.CommandPool, 0);
+
 	VkCommandBufferBeginInfo bufferBeginInfo = {};
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -664,6 +2053,7 @@ void VulkanRenderer::RecordCommands()
 	renderPassBeginInfo.renderPass = s_Context->RenderPass;
 	renderPassBeginInfo.renderArea.offset = { 0, 0 };
 	renderPassBeginInfo.renderArea.extent = s_Context->SwapChainExtent;
+	renderPassBeginInfo.framebuffer = s_Context->SwapChainFramebuffers[imageIndex];
 
 	constexpr VkClearValue clearValues[] = {
 		{ 0.6f, 0.65f, 0.4f, 1.0f }
@@ -672,52 +2062,376 @@ void VulkanRenderer::RecordCommands()
 	renderPassBeginInfo.clearValueCount = (uint32_t)std::size(clearValues);
 	renderPassBeginInfo.pClearValues = clearValues;
 
-	for (size_t i = 0; i < s_Context->CommandBuffers.size(); i++)
+	const auto& commandBuffer = frame.CommandBuffer;
+
+	if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+
+	VulkanGpuProfiler::BeginRecording(frameIndex, commandBuffer, reuseSecondaries ? frame.SecondaryZoneCount : 0);
+
+	// Before any zone of the primary so the secondaries' zones come first, which is what lets them be kept when the secondaries are reused
+	if (recordInParallel && !reuseSecondaries)
+	{
+		// Every task records a contiguous slice of the draw list so the draw order is preserved
+		const uint32_t taskCount = (uint32_t)frame.SecondaryCommandBuffers.size();
+		const size_t drawsPerTask = (s_DrawList.size() + taskCount - 1) / taskCount;
+		std::vector<DrawCounters> taskCounters(taskCount);
+
+		s_Context->RecordingThreadPool->ParallelFor(taskCount, [&](uint32_t taskIndex)
+		{
+			const size_t firstDraw = std::min(s_DrawList.size(), taskIndex * drawsPerTask);
+			const size_t lastDraw = std::min(s_DrawList.size(), firstDraw + drawsPerTask);
+			RecordSecondaryCommands(frameIndex, taskIndex, firstDraw, lastDraw, taskCounters[taskIndex]);
+		});
+
+		frame.SecondaryCounters = {};
+		for (const auto& taskCounter : taskCounters)
+		{
+			frame.SecondaryCounters.DrawCalls += taskCounter.DrawCalls;
+			frame.SecondaryCounters.PipelineBinds += taskCounter.PipelineBinds;
+			frame.SecondaryCounters.BufferBinds += taskCounter.BufferBinds;
+		}
+
+		frame.SecondaryZoneCount = VulkanGpuProfiler::GetZoneCount(frameIndex);
+	}
+
+	frame.SecondariesRecorded = recordInParallel;
+
+	DrawCounters counters;
+
+	if (s_Context->GpuDriven)
+	{
+		VulkanGpuProfiler::ScopedZone zone(frameIndex, commandBuffer, "Culling");
+		RecordCulling(commandBuffer, frameIndex, counters);
+	}
+
 	{
-		const auto& commandBuffer = s_Context->CommandBuffers[i];
-		renderPassBeginInfo.framebuffer = s_Context->SwapChainFramebuffers[i];
+		VulkanGpuProfiler::ScopedZone zone(frameIndex, commandBuffer, "Main pass");
+		VulkanGpuProfiler::BeginPipelineStatistics(frameIndex, commandBuffer);
 
-		if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS)
-			throw std::runtime_error("Failed to start recording a Command Buffer!");
+		if (s_Context->GpuDriven)
+		{
+			// The draws are only known once the cull pass runs, so recording doesn't depend on the scene and is never split
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			RecordIndirectDraw(commandBuffer, frameIndex, counters);
+		}
+		else if (recordInParallel)
+		{
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(commandBuffer, (uint32_t)frame.SecondaryCommandBuffers.size(), frame.SecondaryCommandBuffers.data());
 
+			counters.DrawCalls += frame.SecondaryCounters.DrawCalls;
+			counters.PipelineBinds += frame.SecondaryCounters.PipelineBinds;
+			counters.BufferBinds += frame.SecondaryCounters.BufferBinds;
+		}
+		else
 		{
 			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			RecordDrawList(commandBuffer, frameIndex, 0, s_DrawList.size(), counters);
+		}
 
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, s_Context->GraphicsPipeline);
+		vkCmdEndRenderPass(commandBuffer);
+		VulkanGpuProfiler::EndPipelineStatistics(frameIndex, commandBuffer);
+	}
 
-			for (const auto& mesh : s_Meshes)
-			{
-				const VkBuffer vertexBuffers[] = { mesh.GetVertexBuffer() };
-				constexpr VkDeviceSize offsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, (uint32_t)std::size(vertexBuffers), vertexBuffers, offsets);
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
 
-				vkCmdBindIndexBuffer(commandBuffer, mesh.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	frame.RecordedDrawList = s_DrawList;
+	frame.RecordedImageIndex = imageIndex;
+	frame.RecordedMeshGeneration = s_MeshGeneration;
+	frame.RecordedPipelineGeneration = s_PipelineGeneration;
+	frame.RecordedViewProjection = s_ViewProjection;
+	frame.RecordedCounters = counters;
+	frame.BuffersRecreated = false;
+}
 
-				vkCmdDrawIndexed(commandBuffer, mesh.GetIndicesCount(), 1, 0, 0, 0);
-			}
+void VulkanRenderer::RecordSecondaryCommands(uint32_t frameIndex, uint32_t taskIndex, size_t firstDraw, size_t lastDraw, DrawCounters& counters)
+{
+	PROFILE_FUNCTION();
+
+	const auto& frame = s_Context->Frames[frameIndex];
+	const auto& commandBuffer = frame.SecondaryCommandBuffers[taskIndex];
+
+	vkResetCommandPool(s_Context->LogicalDevice, frame.SecondaryCommandPools[taskIndex], 0);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = s_Context->RenderPass;
+	inheritanceInfo.subpass = 0;
+	// Left out so the recording works with every swapchain image's framebuffer
+	inheritanceInfo.framebuffer = nullptr;
+	inheritanceInfo.pipelineStatistics = VulkanGpuProfiler::GetPipelineStatisticFlags();
+
+	VkCommandBufferBeginInfo bufferBeginInfo = {};
+	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+
+	// Empty slices still get executed, they just don't draw anything
+	{
+		VulkanGpuProfiler::ScopedZone zone(frameIndex, commandBuffer, "Draw group " + std::to_string(taskIndex));
+		RecordDrawList(commandBuffer, frameIndex, firstDraw, lastDraw, counters);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+}
+
+void VulkanRenderer::RecordDrawList(VkCommandBuffer commandBuffer, uint32_t frameIndex, size_t firstDraw, size_t lastDraw, DrawCounters& counters)
+{
+	if (firstDraw == lastDraw)
+		return;
+
+	BindDrawState(commandBuffer, frameIndex, counters);
+	VkPipeline boundPipeline = s_Context->GraphicsPipeline;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	for (size_t i = firstDraw; i < lastDraw; i++)
+	{
+		const auto& draw = s_DrawList[i];
+
+		VkPipeline pipeline = s_MaterialPipelines[draw.Material];
+		if (pipeline == nullptr)
+		{
+			if (!s_Context->DrawCompilingMaterialsWithDefault)
+				continue;
+
+			pipeline = s_Context->GraphicsPipeline;
+		}
 
-			vkCmdEndRenderPass(commandBuffer);
+		// Every material shares the pipeline layout so the push constants and dynamic state stay valid
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+			counters.PipelineBinds++;
+		}
+
+		const auto& mesh = s_Meshes[draw.Mesh];
+
+		// Meshes are either 16 or 32 bit, rebinding the same buffer with the other type is cheap
+		if (mesh.GetIndexType() != boundIndexType)
+		{
+			boundIndexType = mesh.GetIndexType();
+			vkCmdBindIndexBuffer(commandBuffer, s_Context->GeometryPool.GetIndexBuffer(), 0, boundIndexType);
+			counters.BufferBinds++;
 		}
 
-		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-			throw std::runtime_error("Failed to stop recording a Command Buffer!");
+		vkCmdDrawIndexed(commandBuffer, draw.IndexCount, draw.InstanceCount, draw.FirstIndex, mesh.GetVertexOffset(), draw.FirstInstance);
+		counters.DrawCalls++;
 	}
 }
 
-void VulkanRenderer::CreateSynchronization()
+void VulkanRenderer::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters)
 {
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	const auto& frame = s_Context->Frames[frameIndex];
+	if (frame.InstanceCapacity == 0)
+		return;
+
+	vkCmdFillBuffer(commandBuffer, frame.DrawCountBuffer, 0, sizeof(uint32_t) * 2, 0);
+
+	VkMemoryBarrier resetBarrier = {};
+	resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, s_Context->CullingPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, s_Context->CullingPipelineLayout, 0, 1, &frame.CullingDescriptorSet, 0, nullptr);
+
+	// Dispatched for the whole capacity so the recording survives the object count changing, the shader skips the excess
+	vkCmdDispatch(commandBuffer, (frame.InstanceCapacity + Utils::CULLING_GROUP_SIZE - 1) / Utils::CULLING_GROUP_SIZE, 1, 1);
+	counters.PipelineBinds++;
+	counters.DispatchCalls++;
+
+	VkMemoryBarrier cullBarrier = {};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
 
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+void VulkanRenderer::RecordIndirectDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters)
+{
+	const auto& frame = s_Context->Frames[frameIndex];
+	if (frame.InstanceCapacity == 0)
+		return;
+
+	BindDrawState(commandBuffer, frameIndex, counters);
+
+	// The draws written by the cull pass aren't known on the CPU, every index type counts as one.
+	// 16 bit draws fill the first half of the buffer and 32 bit ones the second, each half has its own count
+	const VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+	for (uint32_t i = 0; i < (uint32_t)std::size(indexTypes); i++)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, s_Context->GeometryPool.GetIndexBuffer(), 0, indexTypes[i]);
+		counters.BufferBinds++;
+
+		vkCmdDrawIndexedIndirectCount(commandBuffer, frame.DrawCommandBuffer, sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)frame.InstanceCapacity * i,
+			frame.DrawCountBuffer, sizeof(uint32_t) * i, frame.InstanceCapacity, sizeof(VkDrawIndexedIndirectCommand));
+		counters.DrawCalls++;
+	}
+}
+
+void VulkanRenderer::BindDrawState(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, s_Context->GraphicsPipeline);
+	counters.PipelineBinds++;
+	vkCmdPushConstants(commandBuffer, s_Context->PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &s_ViewProjection);
+
+	// Dynamic state isn't inherited by secondary command buffers, every one sets it again
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)s_Context->SwapChainExtent.width;
+	viewport.height = (float)s_Context->SwapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = s_Context->SwapChainExtent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// Every mesh lives in the geometry pool, so the buffers are bound once and draws only differ in their offsets.
+	// The index buffer is bound by the draws, its type depends on the mesh
+	const VkBuffer vertexBuffers[] = { s_Context->GeometryPool.GetVertexBuffer(), s_Context->Frames[frameIndex].InstanceBuffer };
+	constexpr VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, (uint32_t)std::size(vertexBuffers), vertexBuffers, offsets);
+	counters.BufferBinds++;
+}
+
+void VulkanRenderer::UploadInstances(uint32_t frameIndex)
+{
+	PROFILE_FUNCTION();
+
+	auto& frame = s_Context->Frames[frameIndex];
+	if (s_Instances.empty())
+		return;
+
+	// The frame's timeline value has been waited on, so its buffers can be replaced when they're too small
+	if (s_Instances.size() > frame.InstanceCapacity)
+	{
+		frame.InstanceCapacity = std::max((uint32_t)s_Instances.size(), frame.InstanceCapacity * 2);
+		frame.BuffersRecreated = true;
+
+		constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		RecreateBuffer(frame.InstanceBuffer, frame.InstanceBufferAllocation, sizeof(Utils::InstanceData) * (VkDeviceSize)frame.InstanceCapacity,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+
+		if (s_Context->GpuDriven)
+		{
+			RecreateBuffer(frame.ObjectMeshBuffer, frame.ObjectMeshBufferAllocation, sizeof(uint32_t) * (VkDeviceSize)frame.InstanceCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+
+			// Room for every instance with either index type
+			RecreateBuffer(frame.DrawCommandBuffer, frame.DrawCommandBufferAllocation, sizeof(VkDrawIndexedIndirectCommand) * 2 * (VkDeviceSize)frame.InstanceCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+	}
+
+	memcpy(frame.InstanceBufferAllocation.MappedData, s_Instances.data(), sizeof(Utils::InstanceData) * s_Instances.size());
+	s_FrameCounters.UploadedBytes += sizeof(Utils::InstanceData) * s_Instances.size();
+
+	if (s_Context->GpuDriven)
+	{
+		memcpy(frame.ObjectMeshBufferAllocation.MappedData, s_ObjectMeshes.data(), sizeof(uint32_t) * s_ObjectMeshes.size());
+		s_FrameCounters.UploadedBytes += sizeof(uint32_t) * s_ObjectMeshes.size();
+	}
+}
+
+void VulkanRenderer::UploadCullingData(uint32_t frameIndex)
+{
+	PROFILE_FUNCTION();
+
+	auto& frame = s_Context->Frames[frameIndex];
+
+	// The mesh table only changes when meshes are created or destroyed
+	if (frame.MeshDataGeneration != s_MeshGeneration && !s_Meshes.empty())
+	{
+		if (s_Meshes.size() > frame.MeshDataCapacity)
+		{
+			frame.MeshDataCapacity = std::max((uint32_t)s_Meshes.size(), frame.MeshDataCapacity * 2);
+			frame.BuffersRecreated = true;
+
+			RecreateBuffer(frame.MeshDataBuffer, frame.MeshDataBufferAllocation, sizeof(GpuMeshData) * (VkDeviceSize)frame.MeshDataCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		// Destroyed meshes leave zeroed entries behind, no object can reference them
+		auto* meshData = (GpuMeshData*)frame.MeshDataBufferAllocation.MappedData;
+		for (size_t i = 0; i < s_Meshes.size(); i++)
+		{
+			const auto& mesh = s_Meshes[i];
+			meshData[i] = { mesh.GetBoundingSphere(), mesh.GetVertexOffset(), mesh.GetIndexType() == VK_INDEX_TYPE_UINT16 ? 1u : 0u, mesh.GetLodCount(), 0, {} };
+
+			for (uint32_t lod = 0; lod < mesh.GetLodCount(); lod++)
+				meshData[i].Lods[lod] = { mesh.GetFirstIndex(lod), mesh.GetIndicesCount(lod), mesh.GetLodError(lod) };
+		}
+
+		s_FrameCounters.UploadedBytes += sizeof(GpuMeshData) * s_Meshes.size();
+
+		frame.MeshDataGeneration = s_MeshGeneration;
+	}
+
+	CullData cullData;
+	ExtractFrustumPlanes(s_ViewProjection, cullData.FrustumPlanes);
+	cullData.ObjectCount = (uint32_t)s_Instances.size();
+	cullData.ClipW = glm::vec4(s_ViewProjection[0][3], s_ViewProjection[1][3], s_ViewProjection[2][3], s_ViewProjection[3][3]);
+	cullData.WideDrawOffset = frame.InstanceCapacity;
+	cullData.LodScale = GetLodScale(s_ViewProjection);
+	cullData.LodErrorThreshold = s_Context->LodErrorThreshold;
+	memcpy(frame.CullDataBufferAllocation.MappedData, &cullData, sizeof(CullData));
+	s_FrameCounters.UploadedBytes += sizeof(CullData);
+
+	// The set is only complete once there is something to cull. Nothing recorded uses it at this point, the frame's timeline value was waited on
+	if (!frame.BuffersRecreated || frame.InstanceCapacity == 0)
+		return;
+
+	const VkDescriptorBufferInfo bufferInfos[] = {
+		{ frame.InstanceBuffer, 0, VK_WHOLE_SIZE },
+		{ frame.ObjectMeshBuffer, 0, VK_WHOLE_SIZE },
+		{ frame.MeshDataBuffer, 0, VK_WHOLE_SIZE },
+		{ frame.DrawCommandBuffer, 0, VK_WHOLE_SIZE },
+		{ frame.DrawCountBuffer, 0, VK_WHOLE_SIZE },
+		{ frame.CullDataBuffer, 0, VK_WHOLE_SIZE }
+	};
 
-	for (size_t i = 0; i < Utils::MAX_FRAME_DRAWS; i++)
+	VkWriteDescriptorSet descriptorWrites[std::size(bufferInfos)];
+	for (uint32_t i = 0; i < (uint32_t)std::size(bufferInfos); i++)
 	{
-		if (vkCreateSemaphore(s_Context->LogicalDevice, &semaphoreCreateInfo, nullptr, &s_Context->ImageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(s_Context->LogicalDevice, &semaphoreCreateInfo, nullptr, &s_Context->RenderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(s_Context->LogicalDevice, &fenceCreateInfo, nullptr, &s_Context->DrawFences[i]) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
+		descriptorWrites[i] = {};
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = frame.CullingDescriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].descriptorType = i == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
 	}
+
+	vkUpdateDescriptorSets(s_Context->LogicalDevice, (uint32_t)std::size(descriptorWrites), descriptorWrites, 0, nullptr);
+}
+
+void VulkanRenderer::CreateSynchronization()
+{
+	PROFILE_FUNCTION();
+
+	// Starts at 0 so waiting on a frame or image that was never submitted returns right away
+	s_Context->FrameTimeline = Utils::CreateTimelineSemaphore(s_Context->LogicalDevice, 0);
+	s_Context->ImagesInFlight.assign(s_Context->SwapChainImages.size(), 0);
+
+	// Headless frames aren't presented, the timeline is all they need
+	if (s_Context->Headless)
+		return;
+
+	s_Context->ImageAvailableSemaphores = CreateSemaphores(s_Context->FramesInFlight);
+	s_Context->RenderFinishedSemaphores = CreateSemaphores(s_Context->SwapChainImages.size());
 }
@@ -2,16 +2,200 @@
 
 #include "Base.h"
 #include "Window.h"
+#include "VulkanUtils.h"
+#include "VulkanAllocator.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanGpuProfiler.h"
+#include "FramePacer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
+#include <string>
 #include <vector>
 
+struct RendererCreateInfo
+{
+	Ref<Window> Window = nullptr;
+
+	// Renders into device owned images instead of a swapchain, no window or display is required
+	bool Headless = false;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+
+	// Frames the CPU can record ahead of the GPU, more of them trade latency for throughput
+	uint32_t FramesInFlight = Utils::DEFAULT_FRAMES_IN_FLIGHT;
+
+	// FIFO is used instead when the surface doesn't support it, it's the only mode that always is
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// Frames per second Draw is limited to, 0 leaves it to the present mode
+	float TargetFrameRate = 0.0f;
+	// WaitForNextFrame waits for the previous frame to finish on the GPU and for the latest start that still meets
+	// the frame rate, so input sampled right after it is as fresh as possible
+	bool JustInTimePacing = false;
+
+	// Threads recording secondary command buffers, 0 uses every hardware thread and 1 records everything inline
+	uint32_t RecordingThreadCount = 0;
+
+	// Size of the persistently mapped ring every upload is staged through
+	uint64_t StagingBufferSize = 32ull * 1024 * 1024;
+
+	// Every mesh lives in one shared vertex and index buffer of this many elements
+	uint32_t GeometryVertexCapacity = 1024 * 1024;
+	uint32_t GeometryIndexCapacity = 4 * 1024 * 1024;
+
+	// Frustum culls every instance in a compute pass that writes the draws, the frame is drawn with a single vkCmdDrawIndexedIndirectCount.
+	// Requires the multiDrawIndirect and drawIndirectCount features
+	bool GpuDriven = false;
+
+	// Reorders the triangles and vertices of every mesh in CreateMesh for the vertex cache and fetch, worth it for
+	// scanned or exported meshes whose order is arbitrary but it makes creating meshes slower
+	bool OptimizeMeshes = false;
+	MeshOptimizerSettings OptimizerSettings{};
+
+	// Simplifies every mesh in CreateMesh into a chain of index buffers that share its vertices, each object draws the coarsest
+	// level whose error covers at most LodErrorThreshold pixels. The levels take about as much index space again as the mesh
+	bool GenerateLods = false;
+	MeshLodSettings LodSettings{};
+	float LodErrorThreshold = 1.0f;
+
+	// Splits every mesh in CreateMesh into meshlets of up to 64 vertices and 124 triangles. Without GpuDriven each instance drawn at full
+	// detail only draws the meshlets inside the frustum that face the camera, worth it for large dense meshes seen up close
+	bool BuildMeshlets = false;
+
+	// Pipelines are compiled through a cache kept in this file between runs, empty disables it
+	std::string PipelineCachePath = "pipeline_cache.bin";
+
+	// Threads compiling the pipelines of new materials, 0 compiles them in CreateMaterial instead
+	uint32_t PipelineCompileThreadCount = 1;
+	// Draws whose material is still compiling use the default material, otherwise they are skipped until it's ready
+	bool DrawCompilingMaterialsWithDefault = true;
+
+	// Measures the GPU time of the passes and draw groups with timestamp queries
+	bool GpuProfiling = true;
+};
+
+// Fixed function state meshes are drawn with, every unique combination is compiled into its own pipeline
+struct MaterialDescription
+{
+	// Requires the fillModeNonSolid feature
+	bool Wireframe = false;
+	bool DoubleSided = false;
+	bool Blend = true;
+};
+
+// Geometry CreateMeshes copies from, it only has to stay alive during the call
+struct MeshDescription
+{
+	const Utils::VertexData* Vertices = nullptr;
+	uint32_t VerticesCount = 0;
+	const uint32_t* Indices = nullptr;
+	uint32_t IndicesCount = 0;
+};
+
+// Commands in a frame's recording, a recording submitted again counts them again
+struct DrawCounters
+{
+	uint32_t DrawCalls = 0;
+	uint32_t DispatchCalls = 0;
+	uint32_t PipelineBinds = 0;
+	// Vertex and index buffer bind commands
+	uint32_t BufferBinds = 0;
+};
+
+struct FrameCounters
+{
+	DrawCounters Commands{};
+	// Staged through the uploader plus instance and culling data written to mapped buffers
+	uint64_t UploadedBytes = 0;
+	// Blocked on the frame timeline for the frame's slot, its image and just in time pacing
+	float GpuWaitMs = 0.0f;
+	// 0 if the command buffer was reused
+	float RecordMs = 0.0f;
+	// Meshlets tested on the CPU at submit time and how many of them weren't drawn
+	uint32_t ClustersTested = 0;
+	uint32_t ClustersCulled = 0;
+};
+
+// Everything the renderer measures, taken at once
+struct RendererStats
+{
+	uint64_t FrameNumber = 0;
+	FrameCounters LastFrame{};
+
+	// Requires the pipelineStatisticsQuery and inheritedQueries features, read FramesInFlight frames after it was drawn
+	bool PipelineStatisticsAvailable = false;
+	PipelineStatistics LastPipelineStatistics{};
+	std::vector<GpuZoneStats> GpuZones{};
+
+	FrameLatencyStats Latency{};
+	PipelineCompileStats PipelineCompile{};
+	uint32_t PipelineCacheHits = 0;
+	uint32_t PipelineCacheMisses = 0;
+	uint32_t GraphicsPipelineCount = 0;
+	uint64_t UploadSubmitCount = 0;
+	std::vector<VulkanHeapStats> Heaps{};
+	// Summed over every mesh optimized since Init
+	MeshOptimizationStats MeshOptimization{};
+};
+
 class VulkanRenderer
 {
 public:
-	static bool Init(Ref<Window> windowContext);
+	using MeshHandle = uint32_t;
+	using MaterialHandle = uint32_t;
+
+	// Compiled during Init, stands in for materials that are still compiling
+	static constexpr MaterialHandle DEFAULT_MATERIAL = 0;
+
+public:
+	static bool Init(const RendererCreateInfo& createInfo);
+	// Call before sampling input, Draw calls it itself if it wasn't
+	static void WaitForNextFrame();
 	static void Draw();
 	static void Shutdown();
 
+	static MeshHandle CreateMesh(const Utils::VertexData* vertices, uint32_t verticesCount, const uint32_t* indices, uint32_t indicesCount);
+	// Optimizes and simplifies the meshes in parallel on the recording threads, the handles are in the same order
+	static std::vector<MeshHandle> CreateMeshes(const std::vector<MeshDescription>& meshes);
+	// The mesh is released once the frames in flight that might reference it have finished
+	static void DestroyMesh(MeshHandle mesh);
+	// Uploads are submitted with the next Draw, a mesh can be submitted before they finish
+	static bool IsMeshReady(MeshHandle mesh);
+
+	// The pipeline is compiled in the background, it's swapped in at the start of the first Draw after it's done.
+	// If the build fails the material is drawn with the default one from then on
+	static MaterialHandle CreateMaterial(const MaterialDescription& material);
+	static bool IsMaterialReady(MaterialHandle material);
+
+	// Adds the mesh to the draw list of the next Draw call, the list is cleared after every Draw
+	static void Submit(MeshHandle mesh, MaterialHandle material = DEFAULT_MATERIAL);
+	// Draws every instance with a single draw call, consecutive submits of the same mesh and material are merged the same way.
+	// GPU driven rendering draws everything with the default material
+	static void SubmitInstanced(MeshHandle mesh, const Utils::InstanceData* instances, uint32_t instanceCount, MaterialHandle material = DEFAULT_MATERIAL);
+
+	// Pushed to the vertex shader, identity by default so positions are already in clip space.
+	// Without GPU driven rendering, levels of detail are picked with the camera that is set when the mesh is submitted
+	static void SetCamera(const glm::mat4& viewProjection);
+
+	// CPU time spent recording the last frame, 0 if its command buffer was reused
+	static float GetLastRecordTimeMs();
+	static uint32_t GetRecordingThreadCount();
+	static uint32_t GetFramesInFlight();
+	static VkPresentModeKHR GetPresentMode();
+	// Latency ends when the frame is presented if VK_KHR_present_wait is available, otherwise when the GPU finishes it
+	static FrameLatencyStats GetLatencyStats();
+	static PipelineCompileStats GetPipelineCompileStats();
+	// Empty when GPU profiling is off or unsupported
+	static std::vector<GpuZoneStats> GetGpuZoneStats();
+	static RendererStats GetStats();
+
+	static bool IsHeadless();
+	static std::string GetDeviceName();
+	static bool IsGpuDriven();
+
+	// Copies the last drawn frame into outPixels as tightly packed RGBA8 rows
+	static void ReadFrame(std::vector<uint8_t>& outPixels, uint32_t& outWidth, uint32_t& outHeight);
+
 private:
 	static std::vector<const char*> ValidateExtensions();
 	static void CreateInstance(const std::vector<const char*>& extensions);
@@ -19,11 +203,22 @@ private:
 	static void GetPhysicalDevice();
 	static void CreateLogicalDevice();
 	static void CreateSwapChain();
+	// Returns false when the window has no area to present to, the frame has to be skipped
+	static bool RecreateSwapChain();
+	static void CreateOffscreenTargets();
 	static void CreateRenderPass();
 	static void CreateGraphicsPipeline();
+	static void CreateCullingPipeline();
 	static void CreateFramebuffers();
 	static void CreateCommandPool();
-	static void CreateCommandBuffers();
-	static void RecordCommands();
+	static void CreateCommandBuffers(uint32_t recordingThreadCount);
+	static void RecordCommands(uint32_t frameIndex, uint32_t imageIndex, bool drawsChanged);
+	static void RecordSecondaryCommands(uint32_t frameIndex, uint32_t taskIndex, size_t firstDraw, size_t lastDraw, DrawCounters& counters);
+	static void RecordDrawList(VkCommandBuffer commandBuffer, uint32_t frameIndex, size_t firstDraw, size_t lastDraw, DrawCounters& counters);
+	static void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters);
+	static void RecordIndirectDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters);
+	static void BindDrawState(VkCommandBuffer commandBuffer, uint32_t frameIndex, DrawCounters& counters);
+	static void UploadInstances(uint32_t frameIndex);
+	static void UploadCullingData(uint32_t frameIndex);
 	static void CreateSynchronization();
 };
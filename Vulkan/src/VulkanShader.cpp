@@ -1,5 +1,7 @@
 #include "VulkanShader.h"
 
+#include "Profiler.h"
+
 #include <fstream>
 #include <filesystem>
 #include <iostream>
@@ -18,6 +20,8 @@ namespace Utils
 			return VulkanShader::ShaderType::Vertex;
 		if (type == "fragment")
 			return VulkanShader::ShaderType::Fragment;
+		if (type == "compute")
+			return VulkanShader::ShaderType::Compute;
 
 		throw std::runtime_error("Invalid shader string type!");
 	}
@@ -30,6 +34,8 @@ namespace Utils
 				return shaderc_glsl_vertex_shader;
 			case VulkanShader::ShaderType::Fragment: 
 				return shaderc_glsl_fragment_shader;
+			case VulkanShader::ShaderType::Compute:
+				return shaderc_glsl_compute_shader;
 		}
 
 		throw std::runtime_error("Invalid shader type to shaderc!");
@@ -55,11 +61,26 @@ namespace Utils
 				return ".cached_vulkan.vert";
 			case VulkanShader::ShaderType::Fragment:
 				return ".cached_vulkan.frag";
+			case VulkanShader::ShaderType::Compute:
+				return ".cached_vulkan.comp";
 		}
 
 		throw std::runtime_error("Invalid shader type to extension!");
 	}
 
+	// FNV-1a, part of the cached binary's name so editing a shader invalidates its cache
+	static uint64_t HashShaderSource(const std::string& source)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (const char c : source)
+		{
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
 	static std::string ReadFile(const std::string& filepath)
 	{
 		std::string result;
@@ -98,17 +119,19 @@ Ref<VulkanShader> VulkanShader::Create(const std::string& filepath)
 	return shader;
 }
 
-Ref<VulkanShader> VulkanShader::CreateFromSpv(const std::string& name, const std::string& vertexFilepath, const std::string& fragFilepath)
+Ref<VulkanShader> VulkanShader::CreateFromStages(const std::string& name, const std::unordered_map<ShaderType, std::string>& sourceFilepaths)
 {
 	auto shader = std::shared_ptr<VulkanShader>();
-	shader.reset(new VulkanShader({ {ShaderType::Vertex, vertexFilepath}, {ShaderType::Fragment, fragFilepath} }));
-	AddToLibrary(name, shader);
+	shader.reset(new VulkanShader(name, sourceFilepaths));
+	AddToLibrary(shader);
 	return shader;
 }
 
 VulkanShader::VulkanShader(const std::string& filepath)
 	: m_FilePath(filepath)
 {
+	PROFILE_FUNCTION();
+
 	Utils::CreateDirectoryIfNeeded();
 
 	std::string source = Utils::ReadFile(filepath);
@@ -122,27 +145,24 @@ VulkanShader::VulkanShader(const std::string& filepath)
 	m_Name = filepath.substr(lastSlash, count);
 }
 
-VulkanShader::VulkanShader(const std::unordered_map<ShaderType, std::string> filepaths)
+VulkanShader::VulkanShader(const std::string& name, const std::unordered_map<ShaderType, std::string>& sourceFilepaths)
+	: m_Name(name)
 {
-	for (auto&& [stage, path] : filepaths)
-	{
-		std::ifstream in(path, std::ios::binary | std::ios::ate);
+	PROFILE_FUNCTION();
 
-		if (in)
-		{
-			size_t fileSize = in.tellg();
-			std::vector<uint32_t> fileBuffer(fileSize);
+	Utils::CreateDirectoryIfNeeded();
 
-			in.seekg(0);
-			in.read(reinterpret_cast<char*>(fileBuffer.data()), fileSize);
+	for (auto&& [stage, path] : sourceFilepaths)
+		CompileOrGetVulkanBinary(stage, Utils::ReadFile(path), path);
+}
 
-			m_VulkanSPIRV[stage] = fileBuffer;
-		}
-		else
-		{
-			throw std::runtime_error("Failed to open a file!");
-		}
-	}
+const std::vector<uint32_t>& VulkanShader::GetShaderBinary(ShaderType type) const
+{
+	const auto it = m_VulkanSPIRV.find(type);
+	if (it == m_VulkanSPIRV.end())
+		throw std::runtime_error("Shader '" + m_Name + "' doesn't have the requested stage!");
+
+	return it->second;
 }
 
 std::unordered_map<VulkanShader::ShaderType, std::string> VulkanShader::PreProcess(const std::string& source)
@@ -181,51 +201,55 @@ std::unordered_map<VulkanShader::ShaderType, std::string> VulkanShader::PreProce
 
 void VulkanShader::CompileOrGetVulkanBinaries(const std::unordered_map<ShaderType, std::string>& shaderSources)
 {
-	shaderc::Compiler compiler;
-	shaderc::CompileOptions options;
-	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	m_VulkanSPIRV.clear();
+
+	for (auto&& [stage, source] : shaderSources)
+		CompileOrGetVulkanBinary(stage, source, m_FilePath);
+}
+
+void VulkanShader::CompileOrGetVulkanBinary(ShaderType stage, const std::string& source, const std::string& sourceFilepath)
+{
+	PROFILE_FUNCTION();
 
 	std::filesystem::path cacheDirectory = Utils::GetCacheDirectory();
 
-	auto& shaderData = m_VulkanSPIRV;
-	shaderData.clear();
+	std::filesystem::path shaderFilePath = sourceFilepath;
+	std::filesystem::path cachedPath = cacheDirectory / (shaderFilePath.filename().string() + "." + std::to_string(Utils::HashShaderSource(source))
+		+ Utils::ShaderStageCachedVulkanFileExtension(stage));
 
-	for (auto&& [stage, source] : shaderSources)
+	auto& data = m_VulkanSPIRV[stage];
+
+	std::ifstream in(cachedPath, std::ios::in | std::ios::binary);
+	if (in.is_open())
 	{
-		std::filesystem::path shaderFilePath = m_FilePath;
-		std::filesystem::path cachedPath = cacheDirectory / (shaderFilePath.filename().string() + Utils::ShaderStageCachedVulkanFileExtension(stage));
+		in.seekg(0, std::ios::end);
+		size_t size = in.tellg();
+		in.seekg(0, std::ios::beg);
 
-		std::ifstream in(cachedPath, std::ios::in | std::ios::binary);
-		if (in.is_open())
-		{
-			in.seekg(0, std::ios::end);
-			size_t size = in.tellg();
-			in.seekg(0, std::ios::beg);
+		data.resize(size / sizeof(uint32_t));
+		in.read((char*)data.data(), size);
+		return;
+	}
 
-			auto& data = shaderData[stage];
-			data.resize(size / sizeof(uint32_t));
-			in.read((char*)data.data(), size);
-		}
-		else
-		{
-			shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, Utils::VulkanShaderToShaderC(stage), m_FilePath.c_str(), options);
-			if (result.GetCompilationStatus() != shaderc_compilation_status_success)
-			{
-				std::cerr << result.GetErrorMessage() << '\n';
-			}
+	PROFILE_SCOPE("Compile GLSL");
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
 
-			shaderData[stage] = std::vector(result.cbegin(), result.cend());
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, Utils::VulkanShaderToShaderC(stage), sourceFilepath.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+		throw std::runtime_error("Failed to compile shader '" + sourceFilepath + "':\n" + result.GetErrorMessage());
 
-			std::ofstream out(cachedPath, std::ios::out | std::ios::binary);
-			if (out.is_open())
-			{
-				auto& data = shaderData[stage];
-				out.write((char*)data.data(), data.size() * sizeof(uint32_t));
-				out.flush();
-				out.close();
-			}
-		}
+	data = std::vector(result.cbegin(), result.cend());
+
+	std::ofstream out(cachedPath, std::ios::out | std::ios::binary);
+	if (out.is_open())
+	{
+		out.write((char*)data.data(), data.size() * sizeof(uint32_t));
+		out.flush();
+		out.close();
 	}
 }
 
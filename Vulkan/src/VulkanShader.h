@@ -8,22 +8,26 @@
 class VulkanShader
 {
 public:
-	enum class ShaderType { Vertex, Fragment };
+	enum class ShaderType { Vertex, Fragment, Compute };
 
 public:
 	VulkanShader() = delete;
 	VulkanShader(const VulkanShader&) = delete;
 
-	const std::vector<uint32_t>& GetShaderBinary(ShaderType type) { return m_VulkanSPIRV[type]; }
+	// Read by the pipeline compile threads, so it never modifies the shader
+	const std::vector<uint32_t>& GetShaderBinary(ShaderType type) const;
+	const std::string& GetName() const { return m_Name; }
 
 	static Ref<VulkanShader> Create(const std::string& filepath);
-	static Ref<VulkanShader> CreateFromSpv(const std::string& name, const std::string& vertexFilepath, const std::string& fragFilepath);
+	// Compiles every stage from its own GLSL file
+	static Ref<VulkanShader> CreateFromStages(const std::string& name, const std::unordered_map<ShaderType, std::string>& sourceFilepaths);
 
 private:
 	VulkanShader(const std::string& filepath);
-	VulkanShader(const std::unordered_map<ShaderType, std::string> filepaths);
+	VulkanShader(const std::string& name, const std::unordered_map<ShaderType, std::string>& sourceFilepaths);
 
 	void CompileOrGetVulkanBinaries(const std::unordered_map<ShaderType, std::string>& shaderSources);
+	void CompileOrGetVulkanBinary(ShaderType stage, const std::string& source, const std::string& sourceFilepath);
 	static std::unordered_map<ShaderType, std::string> PreProcess(const std::string& source);
 
 private:
@@ -0,0 +1,452 @@
+#include "VulkanUploader.h"
+
+#include "VulkanUtils.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Batches that can be in flight at once, recording a new one waits for the oldest
+static constexpr uint32_t UPLOAD_BATCH_COUNT = 4;
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+struct UploadBatch
+{
+	// Records the copies on the transfer queue
+	VkCommandPool CommandPool = nullptr;
+	VkCommandBuffer CommandBuffer = nullptr;
+
+	// Only used with a dedicated transfer family, acquires the copied ranges on the graphics queue once the copies are done
+	VkCommandPool AcquireCommandPool = nullptr;
+	VkCommandBuffer AcquireCommandBuffer = nullptr;
+
+	// Staging ring bytes the batch holds on to until it completes, alignment padding and wrap around included
+	VkDeviceSize StagingBytes = 0;
+	std::vector<std::pair<VkBuffer, VkBufferCopy>> Copies{};
+};
+
+struct UploaderContext
+{
+	VkDevice LogicalDevice = nullptr;
+	VkQueue TransferQueue = nullptr;
+	uint32_t TransferQueueFamilyIndex = 0;
+	VkQueue GraphicsQueue = nullptr;
+	uint32_t GraphicsQueueFamilyIndex = 0;
+	bool OwnershipTransfer = false;
+
+	// Reaches a ticket once its batch is usable by the graphics queue
+	VkSemaphore Timeline = nullptr;
+	// Only used with a dedicated transfer family, reaches a ticket once its copies are done and the acquire can run
+	VkSemaphore TransferTimeline = nullptr;
+
+	VkBuffer StagingBuffer = nullptr;
+	VulkanAllocation StagingAllocation{};
+	VkDeviceSize StagingSize = 0;
+	VkDeviceSize StagingHead = 0;
+	VkDeviceSize StagingUsed = 0;
+
+	// The batch for ticket t lives in Batches[t % UPLOAD_BATCH_COUNT]
+	UploadBatch Batches[UPLOAD_BATCH_COUNT]{};
+	// Ticket of the batch being recorded, every ticket before it has been submitted
+	UploadTicket NextTicket = 1;
+	// Every ticket up to this one has finished on the GPU
+	UploadTicket CompletedTicket = 0;
+
+	uint64_t SubmitCount = 0;
+	uint64_t UploadedBytes = 0;
+};
+
+static UploaderContext* s_Context = nullptr;
+
+static UploadBatch& GetBatch(UploadTicket ticket)
+{
+	return s_Context->Batches[ticket % UPLOAD_BATCH_COUNT];
+}
+
+static void CreateCommandBuffer(uint32_t queueFamilyIndex, VkCommandPool& outCommandPool, VkCommandBuffer& outCommandBuffer)
+{
+	VkCommandPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+	if (vkCreateCommandPool(s_Context->LogicalDevice, &poolCreateInfo, nullptr, &outCommandPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Command Pool!");
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = outCommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(s_Context->LogicalDevice, &allocInfo, &outCommandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate a Command Buffer!");
+}
+
+static void WaitForBatches(UploadTicket ticket)
+{
+	if (ticket <= s_Context->CompletedTicket)
+		return;
+
+	PROFILE_SCOPE("Wait for uploads");
+
+	// Batches complete in order, reaching the ticket means every batch before it is done too
+	Utils::WaitForTimeline(s_Context->LogicalDevice, s_Context->Timeline, ticket);
+
+	for (UploadTicket t = s_Context->CompletedTicket + 1; t <= ticket; t++)
+	{
+		UploadBatch& batch = GetBatch(t);
+		s_Context->StagingUsed -= batch.StagingBytes;
+		batch.StagingBytes = 0;
+		s_Context->CompletedTicket = t;
+	}
+}
+
+void VulkanUploader::Init(const UploaderCreateInfo& createInfo)
+{
+	s_Context = new UploaderContext();
+	s_Context->LogicalDevice = createInfo.LogicalDevice;
+	s_Context->TransferQueue = createInfo.TransferQueue;
+	s_Context->TransferQueueFamilyIndex = createInfo.TransferQueueFamilyIndex;
+	s_Context->GraphicsQueue = createInfo.GraphicsQueue;
+	s_Context->GraphicsQueueFamilyIndex = createInfo.GraphicsQueueFamilyIndex;
+	s_Context->OwnershipTransfer = createInfo.TransferQueueFamilyIndex != createInfo.GraphicsQueueFamilyIndex;
+	s_Context->StagingSize = createInfo.StagingBufferSize;
+
+	Utils::CreateBufferInfo stagingBufferInfo = {
+		stagingBufferInfo.LogicalDevice = s_Context->LogicalDevice,
+		stagingBufferInfo.BufferSize = s_Context->StagingSize,
+		stagingBufferInfo.BufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		stagingBufferInfo.BufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBufferInfo.Buffer = &s_Context->StagingBuffer,
+		stagingBufferInfo.BufferAllocation = &s_Context->StagingAllocation
+	};
+
+	Utils::CreateBuffer(stagingBufferInfo);
+
+	// Tickets start at 1 so both start out as already reached for ticket 0
+	s_Context->Timeline = Utils::CreateTimelineSemaphore(s_Context->LogicalDevice, 0);
+
+	if (s_Context->OwnershipTransfer)
+		s_Context->TransferTimeline = Utils::CreateTimelineSemaphore(s_Context->LogicalDevice, 0);
+
+	for (auto& batch : s_Context->Batches)
+	{
+		CreateCommandBuffer(s_Context->TransferQueueFamilyIndex, batch.CommandPool, batch.CommandBuffer);
+
+		if (s_Context->OwnershipTransfer)
+			CreateCommandBuffer(s_Context->GraphicsQueueFamilyIndex, batch.AcquireCommandPool, batch.AcquireCommandBuffer);
+	}
+}
+
+void VulkanUploader::Shutdown()
+{
+	if (s_Context == nullptr)
+		return;
+
+	WaitForBatches(s_Context->NextTicket - 1);
+
+	vkDestroySemaphore(s_Context->LogicalDevice, s_Context->TransferTimeline, nullptr);
+	vkDestroySemaphore(s_Context->LogicalDevice, s_Context->Timeline, nullptr);
+
+	for (auto& batch : s_Context->Batches)
+	{
+		vkDestroyCommandPool(s_Context->LogicalDevice, batch.AcquireCommandPool, nullptr);
+		vkDestroyCommandPool(s_Context->LogicalDevice, batch.CommandPool, nullptr);
+	}
+
+	vkDestroyBuffer(s_Context->LogicalDevice, s_Context->StagingBuffer, nullptr);
+	VulkanAllocator::Free(s_Context->StagingAllocation);
+
+	delete s_Context;
+	s_Context = nullptr;
+}
+
+UploadTicket VulkanUploader::UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	RetireCompletedBatches();
+	s_Context->UploadedBytes += size;
+
+	// Uploads bigger than the ring are split, every chunk is copied once the previous ones have been staged
+	const uint8_t* src = (const uint8_t*)data;
+	while (size > 0)
+	{
+		const VkDeviceSize chunkSize = std::min(size, s_Context->StagingSize);
+		const VkDeviceSize stagingOffset = AllocateStaging(chunkSize, STAGING_ALIGNMENT);
+
+		memcpy((uint8_t*)s_Context->StagingAllocation.MappedData + stagingOffset, src, chunkSize);
+
+		VkBufferCopy region = {};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = dstOffset;
+		region.size = chunkSize;
+		GetBatch(s_Context->NextTicket).Copies.emplace_back(dstBuffer, region);
+
+		src += chunkSize;
+		dstOffset += chunkSize;
+		size -= chunkSize;
+	}
+
+	return s_Context->NextTicket;
+}
+
+UploadTicket VulkanUploader::Flush()
+{
+	PROFILE_FUNCTION();
+
+	UploadBatch& batch = GetBatch(s_Context->NextTicket);
+	if (batch.Copies.empty())
+		return s_Context->NextTicket - 1;
+
+	vkResetCommandPool(s_Context->LogicalDevice, batch.CommandPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(batch.CommandBuffer, &beginInfo);
+
+	// Copies into the same buffer are recorded as the regions of a single vkCmdCopyBuffer
+	std::stable_sort(batch.Copies.begin(), batch.Copies.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	std::vector<VkBufferCopy> regions;
+	for (size_t first = 0; first < batch.Copies.size();)
+	{
+		const VkBuffer dstBuffer = batch.Copies[first].first;
+
+		regions.clear();
+		size_t last = first;
+		for (; last < batch.Copies.size() && batch.Copies[last].first == dstBuffer; last++)
+			regions.push_back(batch.Copies[last].second);
+
+		vkCmdCopyBuffer(batch.CommandBuffer, s_Context->StagingBuffer, dstBuffer, (uint32_t)regions.size(), regions.data());
+		first = last;
+	}
+
+	const UploadTicket ticket = s_Context->NextTicket;
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.signalSemaphoreValueCount = 1;
+	timelineSubmitInfo.pSignalSemaphoreValues = &ticket;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.CommandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+
+	if (!s_Context->OwnershipTransfer)
+	{
+		// Later submissions on this queue read the uploaded data as vertices and indices
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+		vkCmdPipelineBarrier(batch.CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkEndCommandBuffer(batch.CommandBuffer);
+
+		submitInfo.pSignalSemaphores = &s_Context->Timeline;
+
+		if (vkQueueSubmit(s_Context->TransferQueue, 1, &submitInfo, nullptr) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit uploads to Queue!");
+	}
+	else
+	{
+		// Release the written ranges to the graphics family, the matching acquire below has to use the same barriers
+		std::vector<VkBufferMemoryBarrier> barriers;
+		GetOwnershipBarriers(batch.Copies, barriers);
+
+		for (auto& barrier : barriers)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+		}
+
+		vkCmdPipelineBarrier(batch.CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, (uint32_t)barriers.size(), barriers.data(), 0, nullptr);
+
+		vkEndCommandBuffer(batch.CommandBuffer);
+
+		submitInfo.pSignalSemaphores = &s_Context->TransferTimeline;
+
+		if (vkQueueSubmit(s_Context->TransferQueue, 1, &submitInfo, nullptr) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit uploads to Queue!");
+
+		vkResetCommandPool(s_Context->LogicalDevice, batch.AcquireCommandPool, 0);
+		vkBeginCommandBuffer(batch.AcquireCommandBuffer, &beginInfo);
+
+		for (auto& barrier : barriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		}
+
+		// The semaphore wait happens at vertex input so the acquire uses the same stage as its source
+		vkCmdPipelineBarrier(batch.AcquireCommandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			0, nullptr, (uint32_t)barriers.size(), barriers.data(), 0, nullptr);
+
+		vkEndCommandBuffer(batch.AcquireCommandBuffer);
+
+		constexpr VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+		VkTimelineSemaphoreSubmitInfo acquireTimelineSubmitInfo = {};
+		acquireTimelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		acquireTimelineSubmitInfo.waitSemaphoreValueCount = 1;
+		acquireTimelineSubmitInfo.pWaitSemaphoreValues = &ticket;
+		acquireTimelineSubmitInfo.signalSemaphoreValueCount = 1;
+		acquireTimelineSubmitInfo.pSignalSemaphoreValues = &ticket;
+
+		VkSubmitInfo acquireSubmitInfo = {};
+		acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmitInfo.pNext = &acquireTimelineSubmitInfo;
+		acquireSubmitInfo.waitSemaphoreCount = 1;
+		acquireSubmitInfo.pWaitSemaphores = &s_Context->TransferTimeline;
+		acquireSubmitInfo.pWaitDstStageMask = &waitStage;
+		acquireSubmitInfo.commandBufferCount = 1;
+		acquireSubmitInfo.pCommandBuffers = &batch.AcquireCommandBuffer;
+		acquireSubmitInfo.signalSemaphoreCount = 1;
+		acquireSubmitInfo.pSignalSemaphores = &s_Context->Timeline;
+
+		if (vkQueueSubmit(s_Context->GraphicsQueue, 1, &acquireSubmitInfo, nullptr) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit upload acquire to Queue!");
+	}
+
+	batch.Copies.clear();
+	s_Context->SubmitCount++;
+
+	s_Context->NextTicket++;
+	BeginBatch();
+
+	return ticket;
+}
+
+bool VulkanUploader::IsComplete(UploadTicket ticket)
+{
+	RetireCompletedBatches();
+	return ticket <= s_Context->CompletedTicket;
+}
+
+void VulkanUploader::Wait(UploadTicket ticket)
+{
+	if (ticket >= s_Context->NextTicket)
+		Flush();
+
+	WaitForBatches(std::min(ticket, s_Context->NextTicket - 1));
+}
+
+uint64_t VulkanUploader::GetSubmitCount()
+{
+	return s_Context->SubmitCount;
+}
+
+uint64_t VulkanUploader::GetUploadedBytes()
+{
+	return s_Context->UploadedBytes;
+}
+
+VkDeviceSize VulkanUploader::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+	UploaderContext& context = *s_Context;
+
+	while (true)
+	{
+		if (context.StagingUsed == 0)
+			context.StagingHead = 0;
+
+		// The ring is free from the head up to the oldest bytes still owned by a batch
+		const VkDeviceSize head = context.StagingHead;
+		const VkDeviceSize tail = (head + context.StagingSize - context.StagingUsed) % context.StagingSize;
+		const VkDeviceSize alignedHead = (head + alignment - 1) & ~(alignment - 1);
+
+		VkDeviceSize offset = UINT64_MAX;
+		VkDeviceSize consumed = 0;
+
+		if (context.StagingUsed < context.StagingSize)
+		{
+			if (head >= tail)
+			{
+				if (alignedHead + size <= context.StagingSize)
+				{
+					offset = alignedHead;
+					consumed = alignedHead - head + size;
+				}
+				else if (size <= tail)
+				{
+					// The end of the ring is skipped and stays owned by the batch until it completes
+					offset = 0;
+					consumed = context.StagingSize - head + size;
+				}
+			}
+			else if (alignedHead + size <= tail)
+			{
+				offset = alignedHead;
+				consumed = alignedHead - head + size;
+			}
+		}
+
+		if (offset != UINT64_MAX)
+		{
+			context.StagingHead = (offset + size) % context.StagingSize;
+			context.StagingUsed += consumed;
+			GetBatch(context.NextTicket).StagingBytes += consumed;
+			return offset;
+		}
+
+		// Out of space, wait for the oldest batch in flight or submit the one being recorded so it can be waited on
+		PROFILE_SCOPE("Staging stall");
+
+		if (context.CompletedTicket + 1 < context.NextTicket)
+			WaitForBatches(context.CompletedTicket + 1);
+		else if (!GetBatch(context.NextTicket).Copies.empty())
+			Flush();
+		else
+			throw std::runtime_error("Upload doesn't fit in the staging buffer!");
+	}
+}
+
+void VulkanUploader::BeginBatch()
+{
+	// The slot of the new batch is reused from UPLOAD_BATCH_COUNT tickets ago, that one has to be finished first
+	if (s_Context->NextTicket > UPLOAD_BATCH_COUNT)
+		WaitForBatches(s_Context->NextTicket - UPLOAD_BATCH_COUNT);
+}
+
+void VulkanUploader::GetOwnershipBarriers(const std::vector<std::pair<VkBuffer, VkBufferCopy>>& copies, std::vector<VkBufferMemoryBarrier>& outBarriers)
+{
+	std::vector<std::pair<VkBuffer, VkBufferCopy>> ranges = copies;
+	std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b)
+	{
+		return a.first != b.first ? a.first < b.first : a.second.dstOffset < b.second.dstOffset;
+	});
+
+	// Ranges that touch or overlap are merged so uploads packed into one buffer need a single barrier
+	for (const auto& [buffer, region] : ranges)
+	{
+		if (!outBarriers.empty() && outBarriers.back().buffer == buffer && outBarriers.back().offset + outBarriers.back().size >= region.dstOffset)
+		{
+			VkBufferMemoryBarrier& last = outBarriers.back();
+			last.size = std::max(last.offset + last.size, region.dstOffset + region.size) - last.offset;
+			continue;
+		}
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = s_Context->TransferQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = s_Context->GraphicsQueueFamilyIndex;
+		barrier.buffer = buffer;
+		barrier.offset = region.dstOffset;
+		barrier.size = region.size;
+		outBarriers.push_back(barrier);
+	}
+}
+
+void VulkanUploader::RetireCompletedBatches()
+{
+	// Already reached, so this doesn't block
+	const UploadTicket reachedTicket = Utils::GetTimelineValue(s_Context->LogicalDevice, s_Context->Timeline);
+	WaitForBatches(std::min(reachedTicket, s_Context->NextTicket - 1));
+}
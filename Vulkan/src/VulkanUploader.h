@@ -0,0 +1,53 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <vulkan/vulkan.h>
+#pragma warning(pop)
+
+#include <cstdint>
+#include <vector>
+
+// Identifies the batch an upload was recorded into, tickets increase monotonically
+using UploadTicket = uint64_t;
+
+struct UploaderCreateInfo
+{
+	VkDevice LogicalDevice;
+	VkQueue TransferQueue;
+	uint32_t TransferQueueFamilyIndex;
+	VkQueue GraphicsQueue;
+	uint32_t GraphicsQueueFamilyIndex;
+	VkDeviceSize StagingBufferSize;
+};
+
+// Copies data to device local buffers through a persistently mapped staging ring.
+// Uploads are recorded into one command buffer per batch and a batch is submitted on Flush with a single vkQueueSubmit.
+// A timeline semaphore is signaled with the batch's ticket once it's usable, so completion is a single counter read.
+// When the transfer queue belongs to its own family the copied ranges are released by it and acquired by the graphics queue,
+// so the copies run alongside rendering and only the acquire is ordered before the draws.
+class VulkanUploader
+{
+public:
+	static void Init(const UploaderCreateInfo& createInfo);
+	static void Shutdown();
+
+	// Stages the data and queues a copy into dstBuffer, the returned ticket completes once the copy is done on the GPU
+	static UploadTicket UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	// Submits every upload queued since the last flush, returns the ticket of the submitted batch
+	static UploadTicket Flush();
+
+	static bool IsComplete(UploadTicket ticket);
+	// Flushes first if the ticket hasn't been submitted yet
+	static void Wait(UploadTicket ticket);
+
+	static uint64_t GetSubmitCount();
+	// Bytes staged since Init
+	static uint64_t GetUploadedBytes();
+
+private:
+	static VkDeviceSize AllocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+	static void BeginBatch();
+	static void GetOwnershipBarriers(const std::vector<std::pair<VkBuffer, VkBufferCopy>>& copies, std::vector<VkBufferMemoryBarrier>& outBarriers);
+	static void RetireCompletedBatches();
+};
@@ -2,6 +2,8 @@
 
 #include "Base.h"
 #include "Window.h"
+#include "VulkanAllocator.h"
+#include "VertexLayout.h"
 
 #pragma warning(push, 0)
 #include <vulkan/vulkan.h>
@@ -14,27 +16,80 @@
 
 namespace Utils
 {
-	static constexpr uint32_t MAX_FRAME_DRAWS = 2;
+	// Frames the CPU can record ahead of the GPU when RendererCreateInfo doesn't say otherwise
+	static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+	// Draw lists shorter than this are recorded inline on the calling thread
+	static constexpr size_t PARALLEL_RECORDING_MIN_DRAWS = 512;
+
+	// Objects culled per workgroup, matches local_size_x in Cull.comp
+	static constexpr uint32_t CULLING_GROUP_SIZE = 64;
+	// Levels of detail a mesh can have including the full one, matches MAX_LODS in Cull.comp
+	static constexpr uint32_t MAX_MESH_LODS = 8;
+
+	// Timestamp zones a frame can record, the rest are dropped
+	static constexpr uint32_t MAX_GPU_ZONES_PER_FRAME = 64;
+	// Samples the GPU zone stats are computed from
+	static constexpr uint32_t GPU_ZONE_HISTORY_SIZE = 256;
 
 	static const std::vector<const char*> s_DeviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 
+	// Format of the device owned images used as render targets in headless mode
+	static constexpr VkFormat HEADLESS_IMAGE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// What meshes are created from, it's packed into a PackedVertex before being uploaded
 	struct VertexData
 	{
 		glm::vec3 Position;
 		glm::vec4 Color;
+		glm::vec3 Normal = { 0.0f, 0.0f, 1.0f };
+	};
+
+	// Layout of the geometry pool's vertices, 16 bytes instead of the 40 of VertexData.
+	// Positions keep about 3 significant digits and have to stay within half float range
+	struct PackedVertex
+	{
+		// w is always 1
+		Half4 Position;
+		Unorm8x4 Color;
+		// Octahedral encoding of the unit normal
+		Snorm16x2 Normal;
 	};
 
+	static constexpr auto PACKED_VERTEX_LAYOUT = MakeVertexLayout<PackedVertex>(
+		VERTEX_ATTRIBUTE(PackedVertex, Position),
+		VERTEX_ATTRIBUTE(PackedVertex, Color),
+		VERTEX_ATTRIBUTE(PackedVertex, Normal));
+
+	// Per instance attributes, read through an instance rate vertex binding
+	struct InstanceData
+	{
+		glm::mat4 Transform;
+		glm::vec4 Color;
+	};
+
+	static constexpr auto INSTANCE_LAYOUT = MakeVertexLayout<InstanceData>(
+		VERTEX_ATTRIBUTE(InstanceData, Transform),
+		VERTEX_ATTRIBUTE(InstanceData, Color));
+
 	struct QueueFamilyIndices
 	{
 		int32_t GraphicsFamily = -1;
 		int32_t PresentationFamily = -1;
+		// Same as GraphicsFamily when the device has no transfer only family
+		int32_t TransferFamily = -1;
 
 		bool AreValid() const
 		{
 			return GraphicsFamily >= 0 && PresentationFamily >= 0;
 		}
+
+		bool HasDedicatedTransfer() const
+		{
+			return TransferFamily != GraphicsFamily;
+		}
 	};
 
 	struct SwapChainDetails
@@ -86,7 +141,7 @@ namespace Utils
 		return true;
 	}
 
-	static bool CheckDeviceExtensionSupport(VkPhysicalDevice device)
+	static bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& deviceExtensions)
 	{
 		uint32_t extensionCount = 0;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -97,7 +152,7 @@ namespace Utils
 		std::vector<VkExtensionProperties> extensionsProps(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensionsProps.data());
 
-		for (const char* extension : s_DeviceExtensions)
+		for (const char* extension : deviceExtensions)
 		{
 			bool hasExtension = false;
 
@@ -129,21 +184,34 @@ namespace Utils
 
 		for (int32_t i = 0; const auto & queueFamily : queueFamilies)
 		{
-			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-				indices.GraphicsFamily = i;
-
-			VkBool32 presentationSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+			// A family that can transfer but can't do graphics or compute is usually backed by the copy engines
+			constexpr VkQueueFlags nonTransferFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+			if (indices.TransferFamily < 0 && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & nonTransferFlags))
+				indices.TransferFamily = i;
 
-			if (queueFamily.queueCount > 0 && presentationSupport)
-				indices.PresentationFamily = i;
-
-			if (indices.AreValid())
-				break;
+			if (!indices.AreValid())
+			{
+				if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+					indices.GraphicsFamily = i;
+
+				// Without a surface (headless) nothing is presented, the graphics family stands in for presentation
+				VkBool32 presentationSupport = false;
+				if (surface != nullptr)
+					vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+				else
+					presentationSupport = indices.GraphicsFamily == i;
+
+				if (queueFamily.queueCount > 0 && presentationSupport)
+					indices.PresentationFamily = i;
+			}
 
 			i++;
 		}
 
+		// Graphics queues can always transfer, uploads fall back to it
+		if (indices.TransferFamily < 0)
+			indices.TransferFamily = indices.GraphicsFamily;
+
 		return indices;
 	}
 
@@ -179,14 +247,30 @@ namespace Utils
 		VkPhysicalDeviceProperties props;
 		vkGetPhysicalDeviceProperties(device, &props);
 
-		VkPhysicalDeviceFeatures features;
-		vkGetPhysicalDeviceFeatures(device, &features);
+		// Frame and upload synchronization is built on timeline semaphores
+		if (props.apiVersion < VK_API_VERSION_1_2)
+			return false;
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		if (!vulkan12Features.timelineSemaphore)
+			return false;
 
 		outIndices = GetQueueFamilies(device, surface);
 		if (!outIndices.AreValid())
 			return false;
 
-		if (!CheckDeviceExtensionSupport(device))
+		// Headless devices only render offscreen so they don't need any presentation support
+		if (surface == nullptr)
+			return true;
+
+		if (!CheckDeviceExtensionSupport(device, s_DeviceExtensions))
 			return false;
 
 		outSwapChainDetails = GetSwapChainDetails(device, surface);
@@ -210,10 +294,10 @@ namespace Utils
 		return formats[0];
 	}
 
-	static VkPresentModeKHR ChooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes)
+	static VkPresentModeKHR ChooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes, VkPresentModeKHR preferredMode)
 	{
 		for (const auto& presentationMode : presentationModes)
-			if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			if (presentationMode == preferredMode)
 				return presentationMode;
 
 		// This format is always available according to Vulkan spec
@@ -296,30 +380,14 @@ namespace Utils
 
 	struct CreateBufferInfo
 	{
-		VkPhysicalDevice PhysicalDevice;
 		VkDevice LogicalDevice;
 		VkDeviceSize BufferSize;
 		VkBufferUsageFlags BufferUsage;
 		VkMemoryPropertyFlags BufferProperties;
 		VkBuffer* Buffer;
-		VkDeviceMemory* BufferMemory;
+		VulkanAllocation* BufferAllocation;
 	};
 
-	static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags flags)
-	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-		{
-			VkMemoryType& memType = memProperties.memoryTypes[i];
-			if (allowedTypes & (1 << i) && (memType.propertyFlags & flags) == flags)
-				return i;
-		}
-
-		return UINT32_MAX;
-	}
-
 	static void CreateBuffer(const CreateBufferInfo& createBufferInfo)
 	{
 		VkBufferCreateInfo bufferCreateInfo = {};
@@ -331,67 +399,79 @@ namespace Utils
 		if (vkCreateBuffer(createBufferInfo.LogicalDevice, &bufferCreateInfo, nullptr, createBufferInfo.Buffer) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create a Buffer");
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(createBufferInfo.LogicalDevice, *createBufferInfo.Buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryTypeIndex(createBufferInfo.PhysicalDevice, memRequirements.memoryTypeBits, createBufferInfo.BufferProperties);
-
-		if (vkAllocateMemory(createBufferInfo.LogicalDevice, &allocInfo, nullptr, createBufferInfo.BufferMemory) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate Buffer Memory!");
-
-		vkBindBufferMemory(createBufferInfo.LogicalDevice, *createBufferInfo.Buffer, *createBufferInfo.BufferMemory, 0);
+		*createBufferInfo.BufferAllocation = VulkanAllocator::AllocateBufferMemory(*createBufferInfo.Buffer, createBufferInfo.BufferProperties);
 	}
 
-	struct CopyBufferInfo
-	{
-		VkDevice Device;
-		VkQueue TransferQueue;
-		VkCommandPool TransferCommandPool;
-		VkBuffer SrcBuffer;
-		VkBuffer DstBuffer;
-		VkDeviceSize BufferSize;
-	};
-
-	static void CopyBuffer(const CopyBufferInfo& copyBufferInfo)
+	static VkSemaphore CreateTimelineSemaphore(VkDevice logicalDevice, uint64_t initialValue)
 	{
-		VkCommandBuffer transferCommandBuffer;
-
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = copyBufferInfo.TransferCommandPool;
-		allocInfo.commandBufferCount = 1;
-
-		if (vkAllocateCommandBuffers(copyBufferInfo.Device, &allocInfo, &transferCommandBuffer) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate a Command Buffer!");
+		VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+		typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeCreateInfo.initialValue = initialValue;
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VkSemaphoreCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		createInfo.pNext = &typeCreateInfo;
 
-		vkBeginCommandBuffer(transferCommandBuffer, &beginInfo);
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(logicalDevice, &createInfo, nullptr, &semaphore) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a Timeline Semaphore!");
 
-		VkBufferCopy bufferCopyRegion = {
-			bufferCopyRegion.srcOffset = 0,
-			bufferCopyRegion.dstOffset = 0,
-			bufferCopyRegion.size = copyBufferInfo.BufferSize
-		};
+		return semaphore;
+	}
 
-		vkCmdCopyBuffer(transferCommandBuffer, copyBufferInfo.SrcBuffer, copyBufferInfo.DstBuffer, 1, &bufferCopyRegion);
+	// Blocks until the semaphore reaches value
+	static void WaitForTimeline(VkDevice logicalDevice, VkSemaphore semaphore, uint64_t value)
+	{
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
 
-		vkEndCommandBuffer(transferCommandBuffer);
+		vkWaitSemaphores(logicalDevice, &waitInfo, UINT64_MAX);
+	}
 
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &transferCommandBuffer;
+	static uint64_t GetTimelineValue(VkDevice logicalDevice, VkSemaphore semaphore)
+	{
+		uint64_t value = 0;
+		vkGetSemaphoreCounterValue(logicalDevice, semaphore, &value);
+		return value;
+	}
 
-		vkQueueSubmit(copyBufferInfo.TransferQueue, 1, &submitInfo, nullptr);
-		vkQueueWaitIdle(copyBufferInfo.TransferQueue);
+	struct CreateImageInfo
+	{
+		VkDevice LogicalDevice;
+		uint32_t Width;
+		uint32_t Height;
+		VkFormat Format;
+		VkImageTiling Tiling;
+		VkImageUsageFlags ImageUsage;
+		VkMemoryPropertyFlags ImageProperties;
+		VkImage* Image;
+		VulkanAllocation* ImageAllocation;
+	};
 
-		vkFreeCommandBuffers(copyBufferInfo.Device, copyBufferInfo.TransferCommandPool, 1, &transferCommandBuffer);
+	static void CreateImage(const CreateImageInfo& createImageInfo)
+	{
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent.width = createImageInfo.Width;
+		imageCreateInfo.extent.height = createImageInfo.Height;
+		imageCreateInfo.extent.depth = 1;
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = createImageInfo.Format;
+		imageCreateInfo.tiling = createImageInfo.Tiling;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = createImageInfo.ImageUsage;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(createImageInfo.LogicalDevice, &imageCreateInfo, nullptr, createImageInfo.Image) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create an Image!");
+
+		*createImageInfo.ImageAllocation = VulkanAllocator::AllocateImageMemory(*createImageInfo.Image, createImageInfo.Tiling, createImageInfo.ImageProperties);
 	}
 }
\ No newline at end of file
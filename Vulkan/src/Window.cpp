@@ -10,6 +10,12 @@ Ref<Window> Window::Create(const char* name, const uint32_t width, const uint32_
 Window::Window(const char* name, const uint32_t width, const uint32_t height)
 {
 	m_Window = glfwCreateWindow((int)width, (int)height, name, nullptr, nullptr);
+
+	glfwSetWindowUserPointer(m_Window, this);
+	glfwSetFramebufferSizeCallback(m_Window, [](GLFWwindow* window, int, int)
+	{
+		((Window*)glfwGetWindowUserPointer(window))->m_Resized = true;
+	});
 }
 
 Window::~Window()
@@ -21,3 +27,10 @@ void Window::GetWidthAndHeight(int32_t& outWidth, int32_t& outHeight) const
 {
 	glfwGetFramebufferSize(m_Window, &outWidth, &outHeight);
 }
+
+bool Window::IsMinimized() const
+{
+	int32_t width, height;
+	GetWidthAndHeight(width, height);
+	return width == 0 || height == 0;
+}
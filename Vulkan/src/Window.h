@@ -14,6 +14,12 @@ public:
 	GLFWwindow* GetGLFWWindow() const { return m_Window; }
 
 	void GetWidthAndHeight(int32_t& outWidth, int32_t& outHeight) const;
+	// The framebuffer is empty while the window is minimized
+	bool IsMinimized() const;
+
+	// Set when the framebuffer changes size, stays set until cleared by whoever reacts to it
+	bool WasResized() const { return m_Resized; }
+	void ClearResized() { m_Resized = false; }
 
 	static Ref<Window> Create(const char* name, const uint32_t width, const uint32_t height);
 
@@ -22,5 +28,6 @@ private:
 
 private:
 	GLFWwindow* m_Window = nullptr;
+	bool m_Resized = false;
 };
 
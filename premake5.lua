@@ -21,4 +21,5 @@ group "Dependencies"
 	include "Vulkan/vendor/GLFW"
 group ""
 
-include "Vulkan"
\ No newline at end of file
+include "Vulkan"
+include "Benchmark"
\ No newline at end of file